@@ -113,6 +113,7 @@ CREATE TABLE `characters` (
   `lastlogin` bigint(20) NOT NULL DEFAULT '0',
   `lastip` int(11) NOT NULL DEFAULT '0',
   `save` tinyint(1) NOT NULL DEFAULT '1',
+  `save_sequence` bigint(20) UNSIGNED NOT NULL DEFAULT '0',
   `lastlogout` bigint(20) NOT NULL DEFAULT '0',
   `blessings` int(11) NOT NULL DEFAULT '0',
   `onlinetime` int(11) NOT NULL DEFAULT '0',
@@ -812,7 +813,8 @@ ALTER TABLE `tickets`
 -- Indexes for table `tile_store`
 --
 ALTER TABLE `tile_store`
-  ADD PRIMARY KEY (`id`);
+  ADD PRIMARY KEY (`id`),
+  ADD KEY `tile_store_house_id_index` (`house_id`);
 
 --
 -- Indexes for table `towns`
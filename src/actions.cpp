@@ -25,6 +25,7 @@
 #include "configmanager.h"
 #include "container.h"
 #include "game.h"
+#include "iologindata.h"
 #include "pokemon.h"
 #include "pugicast.h"
 #include "moves.h"
@@ -306,6 +307,20 @@ ReturnValue Actions::internalUseItem(Player* player, const Position& pos, uint8_
 
 		//depot container
 		if (DepotLocker* depot = container->getDepotLocker()) {
+			if (!player->areStoredItemsLoaded()) {
+				// open it once the depot items are read
+				uint32_t playerId = player->getID();
+				item->incrementReferenceCounter();
+				IOLoginData::loadStoredItemsAsync(player, [this, playerId, pos, index, item, isHotkey]() {
+					Player* player = g_game.getPlayerByID(playerId);
+					if (player && player->areStoredItemsLoaded() && !item->isRemoved() && Position::areInRange<1, 1, 0>(player->getPosition(), item->getPosition())) {
+						internalUseItem(player, pos, index, item, isHotkey);
+					}
+					g_game.ReleaseItem(item);
+				});
+				return RETURNVALUE_NOERROR;
+			}
+
 			DepotLocker* myDepotLocker = player->getDepotLocker(depot->getDepotId());
 			myDepotLocker->setParent(depot->getParent()->getTile());
 			openContainer = myDepotLocker;
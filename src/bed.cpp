@@ -185,8 +185,9 @@ void BedItem::wakeUp(Player* player)
 
 	if (sleeperGUID != 0) {
 		if (!player) {
+			// a login reading the sleeper would overwrite the regeneration, it is lost then
 			Player regenPlayer(nullptr);
-			if (IOLoginData::loadPlayerById(&regenPlayer, sleeperGUID)) {
+			if (!IOLoginData::isLoadingPlayer(sleeperGUID) && IOLoginData::loadPlayerById(&regenPlayer, sleeperGUID)) {
 				regeneratePlayer(&regenPlayer);
 				IOLoginData::savePlayer(&regenPlayer);
 			}
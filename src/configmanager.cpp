@@ -81,6 +81,47 @@ bool getGlobalBoolean(lua_State* L, const char* identifier, const bool defaultVa
 	return val != 0;
 }
 
+void loadPacketCosts(lua_State* L, uint16_t* packetCost)
+{
+	// packets that make the dispatcher do much more work than a step
+	std::fill(packetCost, packetCost + 256, 1);
+	packetCost[0x64] = 2; // auto walk
+	packetCost[0x78] = 2; // throw
+	packetCost[0x82] = 2; // use item
+	packetCost[0x83] = 2; // use item with
+	packetCost[0x84] = 2; // use with creature
+	packetCost[0x8C] = 2; // look at
+	packetCost[0x96] = 2; // say
+	packetCost[0x97] = 3; // request channels
+	packetCost[0x7D] = 3; // request trade
+	packetCost[0xCB] = 5; // browse field
+	packetCost[0xD2] = 5; // request outfit
+	packetCost[0xF0] = 5; // quest log
+	packetCost[0xF1] = 5; // quest line
+	packetCost[0xE6] = 10; // bug report
+	packetCost[0xF2] = 10; // rule violation report
+	packetCost[0xF5] = 10; // market browse
+	packetCost[0xF6] = 10; // market create offer
+	packetCost[0xF7] = 10; // market cancel offer
+	packetCost[0xF8] = 10; // market accept offer
+
+	lua_getglobal(L, "packetCosts");
+	if (lua_istable(L, -1)) {
+		lua_pushnil(L);
+		while (lua_next(L, -2) != 0) {
+			if (lua_isnumber(L, -2) && lua_isnumber(L, -1)) {
+				int32_t opcode = lua_tonumber(L, -2);
+				int32_t cost = lua_tonumber(L, -1);
+				if (opcode >= 0 && opcode <= 0xFF) {
+					packetCost[opcode] = std::min<int32_t>(0xFFFF, std::max<int32_t>(0, cost));
+				}
+			}
+			lua_pop(L, 1);
+		}
+	}
+	lua_pop(L, 1);
+}
+
 }
 
 bool ConfigManager::load()
@@ -112,11 +153,15 @@ bool ConfigManager::load()
 		string[MYSQL_PASS] = getGlobalString(L, "mysqlPass", "");
 		string[MYSQL_DB] = getGlobalString(L, "mysqlDatabase", "rubyserver");
 		string[MYSQL_SOCK] = getGlobalString(L, "mysqlSock", "");
+		string[JOURNAL_FILE] = getGlobalString(L, "journalFile", "data/journal.bin");
 
 		integer[SQL_PORT] = getGlobalNumber(L, "mysqlPort", 3306);
+		integer[DATABASE_WORKER_THREADS] = getGlobalNumber(L, "databaseWorkerThreads", 2);
+		integer[DATABASE_TASK_THREADS] = getGlobalNumber(L, "databaseTaskThreads", 4);
 		integer[GAME_PORT] = getGlobalNumber(L, "gameProtocolPort", 7172);
 		integer[LOGIN_PORT] = getGlobalNumber(L, "loginProtocolPort", 7171);
 		integer[STATUS_PORT] = getGlobalNumber(L, "statusProtocolPort", 7171);
+		integer[HANDSHAKE_WORKER_THREADS] = getGlobalNumber(L, "handshakeWorkerThreads", 2);
 
 		integer[MARKET_OFFER_DURATION] = getGlobalNumber(L, "marketOfferDuration", 30 * 24 * 60 * 60);
 	}
@@ -133,6 +178,7 @@ bool ConfigManager::load()
 	boolean[STAMINA_SYSTEM] = getGlobalBoolean(L, "staminaSystem", true);
 	boolean[WARN_UNSAFE_SCRIPTS] = getGlobalBoolean(L, "warnUnsafeScripts", true);
 	boolean[CONVERT_UNSAFE_SCRIPTS] = getGlobalBoolean(L, "convertUnsafeScripts", true);
+	boolean[ALLOW_PACKET_COMPRESSION] = getGlobalBoolean(L, "allowPacketCompression", false);
 
 	string[DEFAULT_PRIORITY] = getGlobalString(L, "defaultPriority", "high");
 	string[SERVER_NAME] = getGlobalString(L, "serverName", "");
@@ -165,6 +211,8 @@ bool ConfigManager::load()
 	integer[GOBACK_DELAY_INTERVAL] = getGlobalNumber(L, "timeBetweenGoback", 500);
 	integer[MAX_MESSAGEBUFFER] = getGlobalNumber(L, "maxMessageBuffer", 4);
 	integer[KICK_AFTER_MINUTES] = getGlobalNumber(L, "kickIdlePlayerAfterMinutes", 15);
+	integer[UNLOAD_DEPOT_AFTER_MINUTES] = getGlobalNumber(L, "unloadDepotAfterMinutes", 15);
+	integer[UNLOAD_POKEMONS_AFTER_MINUTES] = getGlobalNumber(L, "unloadPokemonsAfterMinutes", 10);
 	integer[PROTECTION_LEVEL] = getGlobalNumber(L, "protectionLevel", 1);
 	integer[DEATH_LOSE_PERCENT] = getGlobalNumber(L, "deathLosePercent", -1);
 	integer[STATUSQUERY_TIMEOUT] = getGlobalNumber(L, "statusTimeout", 5000);
@@ -174,8 +222,13 @@ bool ConfigManager::load()
 	integer[CHECK_EXPIRED_MARKET_OFFERS_EACH_MINUTES] = getGlobalNumber(L, "checkExpiredMarketOffersEachMinutes", 60);
 	integer[MAX_MARKET_OFFERS_AT_A_TIME_PER_PLAYER] = getGlobalNumber(L, "maxMarketOffersAtATimePerPlayer", 100);
 	integer[MAX_PACKETS_PER_SECOND] = getGlobalNumber(L, "maxPacketsPerSecond", 25);
+	loadPacketCosts(L, packetCost);
+	integer[ROLLING_SAVE_WINDOW] = getGlobalNumber(L, "rollingSaveWindow", 600);
+	integer[JOURNAL_INTERVAL] = getGlobalNumber(L, "journalInterval", 1000);
 	integer[TELEPORT_TO_PLAYER_FLOOR] = getGlobalNumber(L, "teleportToPlayerFloor", 1);
 	integer[TELEPORT_TO_PLAYER_TILES] = getGlobalNumber(L, "teleportToPlayerTiles", 8);
+	integer[PACKET_COMPRESSION_THRESHOLD] = getGlobalNumber(L, "packetCompressionThreshold", 1024);
+	integer[PACKET_COMPRESSION_LEVEL] = getGlobalNumber(L, "packetCompressionLevel", 6);
 
 	loaded = true;
 	lua_close(L);
@@ -39,6 +39,7 @@ class ConfigManager
 			STAMINA_SYSTEM,
 			WARN_UNSAFE_SCRIPTS,
 			CONVERT_UNSAFE_SCRIPTS,
+			ALLOW_PACKET_COMPRESSION,
 
 			LAST_BOOLEAN_CONFIG /* this must be the last one */
 		};
@@ -63,6 +64,7 @@ class ConfigManager
 			MAP_AUTHOR,
 			PRIME1,
 			PRIME2,
+			JOURNAL_FILE,
 
 			LAST_STRING_CONFIG /* this must be the last one */
 		};
@@ -91,6 +93,8 @@ class ConfigManager
 			FOODS_DELAY_INTERVAL,
 			GOBACK_DELAY_INTERVAL,
 			KICK_AFTER_MINUTES,
+			UNLOAD_DEPOT_AFTER_MINUTES,
+			UNLOAD_POKEMONS_AFTER_MINUTES,
 			PROTECTION_LEVEL,
 			DEATH_LOSE_PERCENT,
 			STATUSQUERY_TIMEOUT,
@@ -106,6 +110,13 @@ class ConfigManager
 			MAX_PACKETS_PER_SECOND,
 			TELEPORT_TO_PLAYER_FLOOR,
 			TELEPORT_TO_PLAYER_TILES,
+			PACKET_COMPRESSION_THRESHOLD,
+			PACKET_COMPRESSION_LEVEL,
+			DATABASE_WORKER_THREADS,
+			DATABASE_TASK_THREADS,
+			HANDSHAKE_WORKER_THREADS,
+			ROLLING_SAVE_WINDOW,
+			JOURNAL_INTERVAL,
 
 			LAST_INTEGER_CONFIG /* this must be the last one */
 		};
@@ -117,10 +128,15 @@ class ConfigManager
 		int32_t getNumber(integer_config_t what) const;
 		bool getBoolean(boolean_config_t what) const;
 
+		uint16_t getPacketCost(uint8_t opcode) const {
+			return packetCost[opcode];
+		}
+
 	private:
 		std::string string[LAST_STRING_CONFIG] = {};
 		int32_t integer[LAST_INTEGER_CONFIG] = {};
 		bool boolean[LAST_BOOLEAN_CONFIG] = {};
+		uint16_t packetCost[256] = {};
 
 		bool loaded = false;
 };
@@ -60,6 +60,35 @@ void ConnectionManager::closeAll()
 	connections.clear();
 }
 
+void HandshakeWorkers::start(size_t threadCount)
+{
+	work.reset(new boost::asio::io_service::work(ioService));
+	for (size_t i = 0; i < threadCount; ++i) {
+		threads.emplace_back([this]() { ioService.run(); });
+	}
+}
+
+void HandshakeWorkers::shutdown()
+{
+	work.reset();
+	ioService.stop();
+	for (std::thread& thread : threads) {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+	threads.clear();
+}
+
+void HandshakeWorkers::addTask(std::function<void(void)> task)
+{
+	if (threads.empty()) {
+		task();
+		return;
+	}
+	ioService.post(std::move(task));
+}
+
 // Connection
 
 void Connection::close(bool force)
@@ -142,17 +171,17 @@ void Connection::parseHeader(const boost::system::error_code& error)
 		return;
 	}
 
-	uint32_t timePassed = std::max<uint32_t>(1, (time(nullptr) - timeConnected) + 1);
-	if ((++packetsSent / timePassed) > static_cast<uint32_t>(g_config.getNumber(ConfigManager::MAX_PACKETS_PER_SECOND))) {
+	// every protocol gets the same ceiling, the game protocol charges its opcodes on top of it
+	const int64_t rate = g_config.getNumber(ConfigManager::MAX_PACKETS_PER_SECOND);
+	const int64_t now = OTSYS_TIME();
+	packetTokens = std::min<int64_t>(rate * 3000, packetTokens + (now - lastPacketRefill) * rate);
+	lastPacketRefill = now;
+	if (packetTokens < 1000) {
 		std::cout << convertIPToString(getIP()) << " disconnected for exceeding packet per second limit." << std::endl;
 		close();
 		return;
 	}
-
-	if (timePassed > 2) {
-		timeConnected = time(nullptr);
-		packetsSent = 0;
-	}
+	packetTokens -= 1000;
 
 	uint16_t size = msg.getLengthHeader();
 	if (size == 0 || size >= NETWORKMESSAGE_MAXSIZE - 16) {
@@ -165,7 +194,8 @@ void Connection::parseHeader(const boost::system::error_code& error)
 		readTimer.async_wait(std::bind(&Connection::handleTimeout, std::weak_ptr<Connection>(shared_from_this()),
 		                                    std::placeholders::_1));
 
-		// Read packet content
+		// Read packet content, the read buffer only grows for large packets
+		msg.reserve(size + NetworkMessage::INITIAL_BUFFER_POSITION);
 		msg.setLength(size + NetworkMessage::HEADER_LENGTH);
 		boost::asio::async_read(socket, boost::asio::buffer(msg.getBodyBuffer(), size),
 		                        std::bind(&Connection::parsePacket, shared_from_this(), std::placeholders::_1));
@@ -217,11 +247,16 @@ void Connection::parsePacket(const boost::system::error_code& error)
 			msg.skipBytes(1);    // Skip protocol ID
 		}
 
-		protocol->onRecvFirstMessage(msg);
+		// the first message carries the RSA block, decrypt it away from the
+		// network thread and only wait for the next packet once it is parsed
+		HandshakeWorkers::getInstance().addTask(std::bind(&Connection::parseFirstMessage, shared_from_this()));
+		return;
 	} else {
 		protocol->onRecvMessage(msg);    // Send the packet to the current protocol
 	}
 
+	msg.shrink();
+
 	try {
 		readTimer.expires_from_now(boost::posix_time::seconds(CONNECTION_READ_TIMEOUT));
 		readTimer.async_wait(std::bind(&Connection::handleTimeout, std::weak_ptr<Connection>(shared_from_this()),
@@ -237,6 +272,21 @@ void Connection::parsePacket(const boost::system::error_code& error)
 	}
 }
 
+void Connection::parseFirstMessage()
+{
+	//handshake worker thread
+	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
+	if (connectionState != CONNECTION_STATE_OPEN) {
+		return;
+	}
+
+	protocol->onRecvFirstMessage(msg);
+	msg.shrink();
+
+	// wait for the next packet
+	accept();
+}
+
 void Connection::send(const OutputMessage_ptr& msg)
 {
 	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
@@ -247,7 +297,20 @@ void Connection::send(const OutputMessage_ptr& msg)
 	bool noPendingWrite = messageQueue.empty();
 	messageQueue.emplace_back(msg);
 	if (noPendingWrite) {
-		internalSend(msg);
+		if (protocol->isCompressionEnabled()) {
+			// let the network thread compress it instead of the caller
+			ioService.post(std::bind(&Connection::sendQueued, shared_from_this()));
+		} else {
+			internalSend(msg);
+		}
+	}
+}
+
+void Connection::sendQueued()
+{
+	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
+	if (!messageQueue.empty()) {
+		internalSend(messageQueue.front());
 	}
 }
 
@@ -268,6 +331,17 @@ void Connection::internalSend(const OutputMessage_ptr& msg)
 	}
 }
 
+size_t Connection::getMemoryUsage()
+{
+	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
+
+	size_t usage = sizeof(Connection) + msg.getCapacity();
+	for (const auto& output : messageQueue) {
+		usage += sizeof(OutputMessage) + output->getCapacity();
+	}
+	return usage;
+}
+
 uint32_t Connection::getIP()
 {
 	std::lock_guard<std::recursive_mutex> lockClass(connectionLock);
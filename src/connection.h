@@ -60,6 +60,28 @@ class ConnectionManager
 		std::mutex connectionManagerLock;
 };
 
+class HandshakeWorkers
+{
+	public:
+		static HandshakeWorkers& getInstance() {
+			static HandshakeWorkers instance;
+			return instance;
+		}
+
+		void start(size_t threadCount);
+		void shutdown();
+
+		// runs the task on a worker, or right away when no worker was started
+		void addTask(std::function<void(void)> task);
+
+	private:
+		HandshakeWorkers() = default;
+
+		boost::asio::io_service ioService;
+		std::unique_ptr<boost::asio::io_service::work> work;
+		std::vector<std::thread> threads;
+};
+
 class Connection : public std::enable_shared_from_this<Connection>
 {
 	public:
@@ -82,8 +104,8 @@ class Connection : public std::enable_shared_from_this<Connection>
 			readTimer(io_service),
 			writeTimer(io_service),
 			service_port(std::move(service_port)),
-			socket(io_service),
-			timeConnected(time(nullptr)) {}
+			ioService(io_service),
+			socket(io_service) {}
 		~Connection();
 
 		friend class ConnectionManager;
@@ -96,16 +118,19 @@ class Connection : public std::enable_shared_from_this<Connection>
 		void send(const OutputMessage_ptr& msg);
 
 		uint32_t getIP();
+		size_t getMemoryUsage();
 
 	private:
 		void parseHeader(const boost::system::error_code& error);
 		void parsePacket(const boost::system::error_code& error);
+		void parseFirstMessage();
 
 		void onWriteOperation(const boost::system::error_code& error);
 
 		static void handleTimeout(ConnectionWeak_ptr connectionWeak, const boost::system::error_code& error);
 
 		void closeSocket();
+		void sendQueued();
 		void internalSend(const OutputMessage_ptr& msg);
 
 		boost::asio::ip::tcp::socket& getSocket() {
@@ -125,10 +150,13 @@ class Connection : public std::enable_shared_from_this<Connection>
 		ConstServicePort_ptr service_port;
 		Protocol_ptr protocol;
 
+		boost::asio::io_service& ioService;
 		boost::asio::ip::tcp::socket socket;
 
-		time_t timeConnected;
-		uint32_t packetsSent = 0;
+		// token bucket of every packet, in thousandths of a token; holds a
+		// second more than the game one so its per opcode drops come first
+		int64_t packetTokens = 0;
+		int64_t lastPacketRefill = 0;
 
 		bool connectionState = CONNECTION_STATE_OPEN;
 		bool receivedFirst = false;
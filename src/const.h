@@ -718,6 +718,9 @@ static constexpr int32_t CHANNEL_GUILD = 0x00;
 static constexpr int32_t CHANNEL_PARTY = 0x01;
 static constexpr int32_t CHANNEL_PRIVATE = 0xFFFF;
 
+//Extended opcodes handled by the server itself
+static constexpr uint8_t EXTENDED_OPCODE_COMPRESSION = 0xFF;
+
 //Reserved player storage key ranges;
 //[10000000 - 20000000];
 static constexpr int32_t PSTRG_RESERVED_RANGE_START = 10000000;
@@ -21,6 +21,7 @@
 #include "otpch.h"
 
 #include "container.h"
+#include "housetile.h"
 #include "iomap.h"
 #include "game.h"
 
@@ -165,6 +166,18 @@ void Container::updateItemPokemonCount(int32_t diff)
 	}
 }
 
+void Container::setHouseItemsChanged()
+{
+	Cylinder* topParent = getTopParent();
+	if (topParent->getCreature()) {
+		return;
+	}
+
+	if (HouseTile* houseTile = dynamic_cast<HouseTile*>(topParent->getParent())) {
+		houseTile->getHouse()->setItemsChanged(true);
+	}
+}
+
 uint8_t Container::getPokemonCount() const
 {
 	return totalPokemon;
@@ -544,6 +557,7 @@ void Container::updateThing(Thing* thing, uint16_t itemId, uint32_t count)
 	item->setSubType(count);
 	updateItemWeight(-oldWeight + item->getWeight());
 	updateItemPokemonCount(-oldPokemonCount + item->getPokemonCount());
+	setHouseItemsChanged();
 
 	//send change to client
 	if (getParent()) {
@@ -567,6 +581,7 @@ void Container::replaceThing(uint32_t index, Thing* thing)
 	item->setParent(this);
 	updateItemWeight(-static_cast<int32_t>(replacedItem->getWeight()) + item->getWeight());
 	updateItemPokemonCount(-static_cast<int8_t>(replacedItem->getPokemonCount()) + item->getPokemonCount());
+	setHouseItemsChanged();
 
 	//send change to client
 	if (getParent()) {
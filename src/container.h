@@ -171,6 +171,8 @@ class Container : public Item, public Cylinder
 		Container* getParentContainer();
 		void updateItemWeight(int32_t diff);
 		void updateItemPokemonCount(int32_t diff);
+		// items changed in place don't reach the tile through its notifications
+		void setHouseItemsChanged();
 
 		friend class ContainerIterator;
 		friend class IOMapSerialize;
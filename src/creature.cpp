@@ -42,6 +42,8 @@ Creature::Creature()
 
 Creature::~Creature()
 {
+	g_game.releaseCreatureID(id);
+
 	for (Creature* summon : summons) {
 		summon->setAttackedCreature(nullptr);
 		summon->removeMaster();
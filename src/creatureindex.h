@@ -0,0 +1,156 @@
+/**
+ * The Ruby Server - a free and open-source Pokémon MMORPG server emulator
+ * Copyright (C) 2018  Mark Samman (TFS) <mark.samman@gmail.com>
+ *                     Leandro Matheus <kesuhige@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FS_CREATUREINDEX_H_58E635E3994C4FCCA2394C6889A6EAF6
+#define FS_CREATUREINDEX_H_58E635E3994C4FCCA2394C6889A6EAF6
+
+// Creature ids of one type are firstId + (generation << SLOT_BITS) + slot.
+// A slot belongs to a creature from setID until it is deleted, the
+// generation changes every time the slot is reused so that stale ids do
+// not find the next creature. Dispatcher thread only.
+template <typename T>
+class CreatureIndex
+{
+	public:
+		static constexpr uint32_t SLOT_BITS = 20;
+		static constexpr uint32_t SLOT_MASK = (1 << SLOT_BITS) - 1;
+
+		CreatureIndex(uint32_t firstId, uint32_t lastId) :
+			firstId(firstId), generations(((lastId - firstId) >> SLOT_BITS) + 1) {}
+
+		// non-copyable
+		CreatureIndex(const CreatureIndex&) = delete;
+		CreatureIndex& operator=(const CreatureIndex&) = delete;
+
+		bool contains(uint32_t id) const {
+			return id >= firstId && ((id - firstId) >> SLOT_BITS) < generations;
+		}
+
+		uint32_t reserve() {
+			uint32_t slot;
+			if (!freeSlots.empty()) {
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			} else if (slots.size() <= SLOT_MASK) {
+				slot = slots.size();
+				slots.emplace_back();
+			} else {
+				return 0;
+			}
+
+			Slot& entry = slots[slot];
+			entry.id = firstId + (entry.generation << SLOT_BITS) + slot;
+			return entry.id;
+		}
+
+		void release(uint32_t id) {
+			Slot* entry = getSlot(id);
+			if (!entry) {
+				return;
+			}
+
+			if (entry->creature) {
+				erase(entry->creature);
+			}
+
+			entry->id = 0;
+			entry->generation = (entry->generation + 1) % generations;
+			freeSlots.push_back((id - firstId) & SLOT_MASK);
+		}
+
+		T* get(uint32_t id) const {
+			const Slot* entry = getSlot(id);
+			return entry ? entry->creature : nullptr;
+		}
+
+		bool insert(T* creature) {
+			Slot* entry = getSlot(creature->getID());
+			if (!entry || entry->creature) {
+				return false;
+			}
+
+			entry->creature = creature;
+			entry->index = creatures.size();
+			creatures.push_back(creature);
+			return true;
+		}
+
+		bool erase(T* creature) {
+			Slot* entry = getSlot(creature->getID());
+			if (!entry || entry->creature != creature) {
+				return false;
+			}
+
+			// keep the list dense, the last creature takes the freed place
+			T* last = creatures.back();
+			creatures[entry->index] = last;
+			getSlot(last->getID())->index = entry->index;
+			creatures.pop_back();
+
+			entry->creature = nullptr;
+			return true;
+		}
+
+		size_t size() const {
+			return creatures.size();
+		}
+		bool empty() const {
+			return creatures.empty();
+		}
+
+		typename std::vector<T*>::const_iterator begin() const {
+			return creatures.begin();
+		}
+		typename std::vector<T*>::const_iterator end() const {
+			return creatures.end();
+		}
+
+	private:
+		struct Slot {
+			uint32_t id = 0;
+			uint32_t generation = 0;
+			uint32_t index = 0;
+			T* creature = nullptr;
+		};
+
+		Slot* getSlot(uint32_t id) {
+			return const_cast<Slot*>(static_cast<const CreatureIndex*>(this)->getSlot(id));
+		}
+		const Slot* getSlot(uint32_t id) const {
+			if (!contains(id)) {
+				return nullptr;
+			}
+
+			uint32_t slot = (id - firstId) & SLOT_MASK;
+			if (slot >= slots.size() || slots[slot].id != id) {
+				return nullptr;
+			}
+			return &slots[slot];
+		}
+
+		std::vector<Slot> slots;
+		std::vector<uint32_t> freeSlots;
+		std::vector<T*> creatures;
+
+		const uint32_t firstId;
+		const uint32_t generations;
+};
+
+#endif
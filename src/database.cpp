@@ -27,8 +27,146 @@
 
 extern ConfigManager g_config;
 
+thread_local Database* Database::threadInstance = nullptr;
+
+using mysql_bool = decltype(MYSQL_BIND::is_unsigned);
+
+// the server is gone for now, the statement is worth trying again
+static bool isConnectionError(unsigned int error)
+{
+	return error == CR_SERVER_LOST || error == CR_SERVER_GONE_ERROR || error == CR_CONN_HOST_ERROR || error == 1053/*ER_SERVER_SHUTDOWN*/ || error == CR_CONNECTION_ERROR;
+}
+
+struct DBParameter {
+	uint64_t integer = 0;
+	std::string data;
+	unsigned long length = 0;
+};
+
+struct DBColumn {
+	uint64_t integer = 0;
+	std::vector<char> data;
+	unsigned long length = 0;
+	mysql_bool isNull = 0;
+	mysql_bool error = 0;
+	bool isInteger = false;
+	bool isUnsigned = false;
+};
+
+struct DBPreparedStatement {
+	explicit DBPreparedStatement(std::string query) : query(std::move(query)) {}
+	~DBPreparedStatement() {
+		close();
+	}
+
+	// non-copyable
+	DBPreparedStatement(const DBPreparedStatement&) = delete;
+	DBPreparedStatement& operator=(const DBPreparedStatement&) = delete;
+
+	bool prepare(MYSQL* handle);
+	void close();
+
+	std::string query;
+	MYSQL_STMT* stmt = nullptr;
+	unsigned int prepareError = 0; // of the last failed prepare
+
+	std::vector<MYSQL_BIND> params;
+	std::vector<DBParameter> paramValues;
+	std::vector<MYSQL_BIND> results;
+	std::vector<DBColumn> columns;
+	bool hasResultSet = false;
+	bool resultStored = false;
+};
+
+bool DBPreparedStatement::prepare(MYSQL* handle)
+{
+	close();
+
+	stmt = mysql_stmt_init(handle);
+	if (!stmt) {
+		prepareError = mysql_errno(handle);
+		return false;
+	}
+
+	if (mysql_stmt_prepare(stmt, query.c_str(), query.length()) != 0) {
+		std::cout << "[Error - mysql_stmt_prepare] Query: " << query.substr(0, 256) << std::endl << "Message: " << mysql_stmt_error(stmt) << std::endl;
+		prepareError = mysql_stmt_errno(stmt);
+		close();
+		return false;
+	}
+
+	// preparing again after the connection was lost keeps what is bound already
+	size_t paramCount = mysql_stmt_param_count(stmt);
+	if (params.size() != paramCount) {
+		params.assign(paramCount, MYSQL_BIND());
+		paramValues.assign(paramCount, DBParameter());
+	}
+
+	results.clear();
+	columns.clear();
+	hasResultSet = false;
+
+	MYSQL_RES* metadata = mysql_stmt_result_metadata(stmt);
+	if (metadata) {
+		hasResultSet = true;
+
+		size_t columnCount = mysql_num_fields(metadata);
+		results.assign(columnCount, MYSQL_BIND());
+		columns.resize(columnCount);
+
+		for (size_t i = 0; i < columnCount; ++i) {
+			MYSQL_FIELD* field = mysql_fetch_field(metadata);
+			DBColumn& column = columns[i];
+			MYSQL_BIND& bind = results[i];
+
+			switch (field->type) {
+				case MYSQL_TYPE_TINY:
+				case MYSQL_TYPE_SHORT:
+				case MYSQL_TYPE_LONG:
+				case MYSQL_TYPE_INT24:
+				case MYSQL_TYPE_LONGLONG:
+				case MYSQL_TYPE_YEAR:
+					column.isInteger = true;
+					column.isUnsigned = (field->flags & UNSIGNED_FLAG) != 0;
+					bind.buffer_type = MYSQL_TYPE_LONGLONG;
+					bind.buffer = &column.integer;
+					bind.is_unsigned = column.isUnsigned;
+					break;
+
+				default:
+					// strings, blobs and decimals come as raw bytes, the buffer grows on demand
+					column.data.resize(64);
+					bind.buffer_type = MYSQL_TYPE_BLOB;
+					bind.buffer = column.data.data();
+					bind.buffer_length = column.data.size();
+					break;
+			}
+
+			bind.length = &column.length;
+			bind.is_null = &column.isNull;
+			bind.error = &column.error;
+		}
+		mysql_free_result(metadata);
+	}
+	return true;
+}
+
+void DBPreparedStatement::close()
+{
+	if (stmt) {
+		mysql_stmt_close(stmt);
+		stmt = nullptr;
+	}
+	resultStored = false;
+}
+
+Database::Database() = default;
+
 Database::~Database()
 {
+	// statements must be closed before their connection
+	statements.clear();
+
 	if (handle != nullptr) {
 		mysql_close(handle);
 	}
@@ -123,7 +261,17 @@ bool Database::executeQuery(const std::string& query)
 
 DBResult_ptr Database::storeQuery(const std::string& query)
 {
-	databaseLock.lock();
+	return internalQuery(query, false);
+}
+
+DBResult_ptr Database::streamQuery(const std::string& query)
+{
+	return internalQuery(query, true);
+}
+
+DBResult_ptr Database::internalQuery(const std::string& query, bool stream)
+{
+	std::unique_lock<std::recursive_mutex> lock(databaseLock);
 
 	retry:
 	while (mysql_real_query(handle, query.c_str(), query.length()) != 0) {
@@ -137,26 +285,45 @@ DBResult_ptr Database::storeQuery(const std::string& query)
 
 	// we should call that every time as someone would call executeQuery('SELECT...')
 	// as it is described in MySQL manual: "it doesn't hurt" :P
-	MYSQL_RES* res = mysql_store_result(handle);
+	MYSQL_RES* res = stream ? mysql_use_result(handle) : mysql_store_result(handle);
 	if (res == nullptr) {
-		std::cout << "[Error - mysql_store_result] Query: " << query << std::endl << "Message: " << mysql_error(handle) << std::endl;
+		std::cout << "[Error - " << (stream ? "mysql_use_result" : "mysql_store_result") << "] Query: " << query << std::endl << "Message: " << mysql_error(handle) << std::endl;
 		auto error = mysql_errno(handle);
 		if (error != CR_SERVER_LOST && error != CR_SERVER_GONE_ERROR && error != CR_CONN_HOST_ERROR && error != 1053/*ER_SERVER_SHUTDOWN*/ && error != CR_CONNECTION_ERROR) {
-			databaseLock.unlock();
 			return nullptr;
 		}
 		goto retry;
 	}
-	databaseLock.unlock();
+
+	// a streamed result still reads from the connection, it keeps the lock
+	if (!stream) {
+		lock.unlock();
+	}
 
 	// retrieving results of query
-	DBResult_ptr result = std::make_shared<DBResult>(res);
+	DBResult_ptr result = std::make_shared<DBResult>(res, handle, std::move(lock));
 	if (!result->hasNext()) {
 		return nullptr;
 	}
 	return result;
 }
 
+DBStatement Database::prepare(const std::string& query)
+{
+	std::unique_lock<std::recursive_mutex> lock(databaseLock);
+
+	auto it = statements.find(query);
+	if (it == statements.end()) {
+		it = statements.emplace(query, std::unique_ptr<DBPreparedStatement>(new DBPreparedStatement(query))).first;
+	}
+
+	DBPreparedStatement* prepared = it->second.get();
+	while (!prepared->stmt && !prepared->prepare(handle) && isConnectionError(prepared->prepareError)) {
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+	return DBStatement(*this, prepared);
+}
+
 std::string Database::escapeString(const std::string& s) const
 {
 	return escapeBlob(s.c_str(), s.length());
@@ -182,57 +349,81 @@ std::string Database::escapeBlob(const char* s, uint32_t length) const
 	return escaped;
 }
 
-DBResult::DBResult(MYSQL_RES* res)
+DBResult::DBResult(MYSQL_RES* res, MYSQL* connection, std::unique_lock<std::recursive_mutex>&& lock) :
+	lock(std::move(lock)), handle(res), connection(connection)
 {
-	handle = res;
+	fields = mysql_fetch_fields(handle);
+	fieldCount = mysql_num_fields(handle);
+	next();
+}
 
-	size_t i = 0;
+DBResult::~DBResult()
+{
+	// for streamed results this also reads whatever rows were left
+	mysql_free_result(handle);
+}
 
-	MYSQL_FIELD* field = mysql_fetch_field(handle);
-	while (field) {
-		listNames[field->name] = i++;
-		field = mysql_fetch_field(handle);
+size_t DBResult::getColumn(const std::string& s) const
+{
+	// few columns per result, a scan beats building a map for every result
+	for (size_t i = 0; i < fieldCount; ++i) {
+		if (s == fields[i].name) {
+			return i;
+		}
 	}
-
-	row = mysql_fetch_row(handle);
+	return INVALID_COLUMN;
 }
 
-DBResult::~DBResult()
+size_t DBResult::getNamedColumn(const std::string& s, const char* caller) const
 {
-	mysql_free_result(handle);
+	size_t column = getColumn(s);
+	if (column == INVALID_COLUMN) {
+		std::cout << "[Error - DBResult::" << caller << "] Column '" << s << "' doesn't exist in the result set" << std::endl;
+	}
+	return column;
 }
 
-std::string DBResult::getString(const std::string& s) const
+const char* DBResult::getValue(size_t column, const char* caller) const
 {
-	auto it = listNames.find(s);
-	if (it == listNames.end()) {
-		std::cout << "[Error - DBResult::getString] Column '" << s << "' does not exist in result set." << std::endl;
-		return std::string();
+	if (column >= fieldCount) {
+		if (column != INVALID_COLUMN) {
+			std::cout << "[Error - DBResult::" << caller << "] Column " << column << " doesn't exist in the result set" << std::endl;
+		}
+		return nullptr;
 	}
+	return row[column];
+}
 
-	if (row[it->second] == nullptr) {
+std::string DBResult::getString(size_t column) const
+{
+	unsigned long size;
+	const char* value = getStream(column, size);
+	if (value == nullptr) {
 		return std::string();
 	}
+	return std::string(value, size);
+}
 
-	return std::string(row[it->second]);
+std::string DBResult::getString(const std::string& s) const
+{
+	return getString(getNamedColumn(s, "getString"));
 }
 
-const char* DBResult::getStream(const std::string& s, unsigned long& size) const
+const char* DBResult::getStream(size_t column, unsigned long& size) const
 {
-	auto it = listNames.find(s);
-	if (it == listNames.end()) {
-		std::cout << "[Error - DBResult::getStream] Column '" << s << "' doesn't exist in the result set" << std::endl;
+	const char* value = getValue(column, "getStream");
+	if (value == nullptr) {
 		size = 0;
 		return nullptr;
 	}
 
-	if (row[it->second] == nullptr) {
-		size = 0;
-		return nullptr;
-	}
+	size = mysql_fetch_lengths(handle)[column];
+	return value;
+}
 
-	size = mysql_fetch_lengths(handle)[it->second];
-	return row[it->second];
+const char* DBResult::getStream(const std::string& s, unsigned long& size) const
+{
+	return getStream(getNamedColumn(s, "getStream"), size);
 }
 
 bool DBResult::hasNext() const
@@ -243,14 +434,258 @@ bool DBResult::hasNext() const
 bool DBResult::next()
 {
 	row = mysql_fetch_row(handle);
+	if (row == nullptr && lock.owns_lock() && mysql_errno(connection) != 0) {
+		std::cout << "[Error - mysql_fetch_row] Message: " << mysql_error(connection) << std::endl;
+	}
 	return row != nullptr;
 }
 
+DBStatement::DBStatement(Database& db, DBPreparedStatement* prepared) :
+	lock(db.databaseLock), db(&db), prepared(prepared) {}
+
+DBStatement::DBStatement(DBStatement&& other) :
+	lock(std::move(other.lock)), db(other.db), prepared(other.prepared), paramIndex(other.paramIndex), hasRow(other.hasRow)
+{
+	other.prepared = nullptr;
+}
+
+DBStatement::~DBStatement()
+{
+	if (prepared && prepared->resultStored) {
+		mysql_stmt_free_result(prepared->stmt);
+		prepared->resultStored = false;
+	}
+}
+
+void DBStatement::bindInteger(uint64_t value, bool isUnsigned)
+{
+	if (paramIndex >= prepared->params.size()) {
+		std::cout << "[Error - DBStatement::bind] Too many parameters for query: " << prepared->query.substr(0, 256) << std::endl;
+		return;
+	}
+
+	DBParameter& parameter = prepared->paramValues[paramIndex];
+	parameter.integer = value;
+
+	MYSQL_BIND& bind = prepared->params[paramIndex++];
+	bind.buffer_type = MYSQL_TYPE_LONGLONG;
+	bind.buffer = &parameter.integer;
+	bind.buffer_length = sizeof(parameter.integer);
+	bind.is_unsigned = isUnsigned;
+	bind.length = nullptr;
+}
+
+DBStatement& DBStatement::bind(const std::string& value)
+{
+	return bindBlob(value.data(), value.length());
+}
+
+DBStatement& DBStatement::bindBlob(const char* data, size_t length)
+{
+	if (paramIndex >= prepared->params.size()) {
+		std::cout << "[Error - DBStatement::bind] Too many parameters for query: " << prepared->query.substr(0, 256) << std::endl;
+		return *this;
+	}
+
+	DBParameter& parameter = prepared->paramValues[paramIndex];
+	parameter.data.assign(data, length);
+	parameter.length = length;
+
+	MYSQL_BIND& bind = prepared->params[paramIndex++];
+	bind.buffer_type = MYSQL_TYPE_BLOB;
+	bind.buffer = &parameter.data[0];
+	bind.buffer_length = length;
+	bind.length = &parameter.length;
+	return *this;
+}
+
+bool DBStatement::execute()
+{
+	hasRow = false;
+	if (!prepared) {
+		return false;
+	}
+
+	if (prepared->resultStored) {
+		mysql_stmt_free_result(prepared->stmt);
+		prepared->resultStored = false;
+	}
+
+	if (paramIndex != prepared->params.size()) {
+		std::cout << "[Error - DBStatement::execute] Expected " << prepared->params.size() << " parameters, got " << paramIndex << " for query: " << prepared->query.substr(0, 256) << std::endl;
+		paramIndex = 0;
+		return false;
+	}
+	paramIndex = 0;
+
+	const size_t boundParams = prepared->params.size();
+	while (true) {
+		if (!prepared->stmt) {
+			// the statement was lost with the connection; like Database::executeQuery,
+			// wait for the server to come back
+			if (!prepared->prepare(db->handle)) {
+				if (!isConnectionError(prepared->prepareError)) {
+					return false;
+				}
+
+				std::this_thread::sleep_for(std::chrono::seconds(1));
+				continue;
+			}
+
+			// never prepared when the parameters were bound, they went nowhere
+			if (prepared->params.size() != boundParams) {
+				std::cout << "[Error - DBStatement::execute] Parameters were bound before the statement got prepared for query: " << prepared->query.substr(0, 256) << std::endl;
+				return false;
+			}
+		}
+
+		if ((prepared->params.empty() || mysql_stmt_bind_param(prepared->stmt, prepared->params.data()) == 0) && mysql_stmt_execute(prepared->stmt) == 0) {
+			break;
+		}
+
+		std::cout << "[Error - mysql_stmt_execute] Query: " << prepared->query.substr(0, 256) << std::endl << "Message: " << mysql_stmt_error(prepared->stmt) << std::endl;
+		auto error = mysql_stmt_errno(prepared->stmt);
+		if (error == 1243/*ER_UNKNOWN_STMT_HANDLER*/) {
+			// the connection was re-established, prepare again
+			prepared->close();
+			continue;
+		}
+
+		if (!isConnectionError(error)) {
+			return false;
+		}
+
+		prepared->close();
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+
+	if (!prepared->hasResultSet) {
+		return true;
+	}
+
+	if (mysql_stmt_store_result(prepared->stmt) != 0 || mysql_stmt_bind_result(prepared->stmt, prepared->results.data()) != 0) {
+		std::cout << "[Error - mysql_stmt_store_result] Query: " << prepared->query.substr(0, 256) << std::endl << "Message: " << mysql_stmt_error(prepared->stmt) << std::endl;
+		return false;
+	}
+
+	prepared->resultStored = true;
+	next();
+	return true;
+}
+
+bool DBStatement::next()
+{
+	if (!prepared || !prepared->resultStored) {
+		hasRow = false;
+		return false;
+	}
+
+	int ret = mysql_stmt_fetch(prepared->stmt);
+	if (ret == MYSQL_DATA_TRUNCATED) {
+		// fetch the columns that did not fit into their buffer again
+		bool rebind = false;
+		for (size_t i = 0, size = prepared->columns.size(); i < size; ++i) {
+			DBColumn& column = prepared->columns[i];
+			if (column.isInteger || column.isNull || column.length <= column.data.size()) {
+				continue;
+			}
+
+			column.data.resize(column.length);
+
+			MYSQL_BIND& bind = prepared->results[i];
+			bind.buffer = column.data.data();
+			bind.buffer_length = column.data.size();
+			mysql_stmt_fetch_column(prepared->stmt, &bind, i, 0);
+			rebind = true;
+		}
+
+		if (rebind) {
+			mysql_stmt_bind_result(prepared->stmt, prepared->results.data());
+		}
+	} else if (ret != 0) {
+		hasRow = false;
+		return false;
+	}
+
+	hasRow = true;
+	return true;
+}
+
+uint64_t DBStatement::getLastInsertId() const
+{
+	return static_cast<uint64_t>(mysql_stmt_insert_id(prepared->stmt));
+}
+
+int64_t DBStatement::getInteger(size_t column) const
+{
+	if (column >= prepared->columns.size()) {
+		std::cout << "[Error - DBStatement::getNumber] Column " << column << " doesn't exist in the result set" << std::endl;
+		return 0;
+	}
+
+	const DBColumn& value = prepared->columns[column];
+	if (value.isNull) {
+		return 0;
+	} else if (value.isInteger) {
+		return static_cast<int64_t>(value.integer);
+	}
+
+	// decimal or text column, parse it
+	std::string text(value.data.data(), std::min<size_t>(value.length, value.data.size()));
+	return std::strtoll(text.c_str(), nullptr, 10);
+}
+
+std::string DBStatement::getString(size_t column) const
+{
+	if (column >= prepared->columns.size()) {
+		std::cout << "[Error - DBStatement::getString] Column " << column << " doesn't exist in the result set" << std::endl;
+		return std::string();
+	}
+
+	const DBColumn& value = prepared->columns[column];
+	if (value.isNull) {
+		return std::string();
+	} else if (value.isInteger) {
+		return value.isUnsigned ? std::to_string(value.integer) : std::to_string(static_cast<int64_t>(value.integer));
+	}
+	return std::string(value.data.data(), std::min<size_t>(value.length, value.data.size()));
+}
+
+const char* DBStatement::getStream(size_t column, unsigned long& size) const
+{
+	if (column >= prepared->columns.size()) {
+		std::cout << "[Error - DBStatement::getStream] Column " << column << " doesn't exist in the result set" << std::endl;
+		size = 0;
+		return nullptr;
+	}
+
+	const DBColumn& value = prepared->columns[column];
+	if (value.isNull || value.isInteger) {
+		size = 0;
+		return nullptr;
+	}
+
+	size = std::min<unsigned long>(value.length, value.data.size());
+	return value.data.data();
+}
+
 DBInsert::DBInsert(const std::string& query) : query(std::move(query))
 {
 	this->length = this->query.length();
 }
 
+void DBInsert::upsert(const std::vector<std::string>& columns)
+{
+	upsertClause = " ON DUPLICATE KEY UPDATE ";
+	for (size_t i = 0; i < columns.size(); ++i) {
+		if (i != 0) {
+			upsertClause.push_back(',');
+		}
+		upsertClause += '`' + columns[i] + "` = VALUES(`" + columns[i] + "`)";
+	}
+	length = query.length() + upsertClause.length();
+}
+
 bool DBInsert::addRow(const std::string& row)
 {
 	// adds new row to buffer
@@ -289,8 +724,8 @@ bool DBInsert::execute()
 	}
 
 	// executes buffer
-	bool res = Database::getInstance().executeQuery(query + values);
+	bool res = Database::getInstance().executeQuery(query + values + upsertClause);
 	values.clear();
-	length = query.length();
+	length = query.length() + upsertClause.length();
 	return res;
 }
\ No newline at end of file
@@ -21,17 +21,17 @@
 #ifndef FS_DATABASE_H_A484B0CDFDE542838F506DCE3D40C693
 #define FS_DATABASE_H_A484B0CDFDE542838F506DCE3D40C693
 
-#include <boost/lexical_cast.hpp>
-
 #include <mysql/mysql.h>
 
 class DBResult;
 using DBResult_ptr = std::shared_ptr<DBResult>;
+class DBStatement;
+struct DBPreparedStatement;
 
 class Database
 {
 	public:
-		Database() = default;
+		Database();
 		~Database();
 
 		// non-copyable
@@ -45,10 +45,24 @@ class Database
 		 */
 		static Database& getInstance()
 		{
+			if (threadInstance) {
+				return *threadInstance;
+			}
+
 			static Database instance;
 			return instance;
 		}
 
+		/**
+		 * Makes getInstance() return the given connection on the calling
+		 * thread, so worker threads do not share the dispatcher connection.
+		 *
+		 * @param db connection owned by the calling thread, nullptr to reset
+		 */
+		static void setThreadInstance(Database* db) {
+			threadInstance = db;
+		}
+
 		/**
 		 * Connects to the database
 		 *
@@ -75,6 +89,30 @@ class Database
 		 */
 		DBResult_ptr storeQuery(const std::string& query);
 
+		/**
+		 * Queries database without buffering the whole result set first.
+		 *
+		 * Rows are fetched from the server while iterating, so large scans
+		 * don't hold every row in memory at once. The connection stays
+		 * locked until the result is released and must not run any other
+		 * query meanwhile.
+		 *
+		 * @return results object (nullptr on error or empty result)
+		 */
+		DBResult_ptr streamQuery(const std::string& query);
+
+		/**
+		 * Prepares a statement, or reuses the one this connection already
+		 * prepared for the same query text.
+		 *
+		 * Parameters are written as ? and bound in order through the
+		 * returned statement, which keeps the connection locked while alive.
+		 *
+		 * @param query statement text
+		 * @return statement handle
+		 */
+		DBStatement prepare(const std::string& query);
+
 		/**
 		 * Escapes string for query.
 		 *
@@ -130,56 +168,153 @@ class Database
 		bool rollback();
 		bool commit();
 
+		DBResult_ptr internalQuery(const std::string& query, bool stream);
+
 		MYSQL* handle = nullptr;
 		std::recursive_mutex databaseLock;
 		uint64_t maxPacketSize = 1048576;
 
+		static thread_local Database* threadInstance;
+
+		std::unordered_map<std::string, std::unique_ptr<DBPreparedStatement>> statements;
+
 	friend class DBTransaction;
+	friend class DBStatement;
+};
+
+/**
+ * Prepared statement with binary parameter and result binding.
+ *
+ * Result columns are read by their position in the SELECT list; integer
+ * columns are fetched as 64-bit values, everything else as raw bytes.
+ */
+class DBStatement
+{
+	public:
+		DBStatement(DBStatement&& other);
+		~DBStatement();
+
+		// non-copyable
+		DBStatement(const DBStatement&) = delete;
+		DBStatement& operator=(const DBStatement&) = delete;
+
+		template<typename T>
+		typename std::enable_if<std::is_integral<T>::value, DBStatement&>::type bind(T value)
+		{
+			bindInteger(static_cast<uint64_t>(value), std::is_unsigned<T>::value);
+			return *this;
+		}
+
+		DBStatement& bind(const std::string& value);
+		DBStatement& bindBlob(const char* data, size_t length);
+
+		/**
+		 * Executes the statement with the parameters bound so far, the
+		 * bindings are cleared afterwards so it can be executed again.
+		 *
+		 * @return true on success, false on error
+		 */
+		bool execute();
+
+		uint64_t getLastInsertId() const;
+
+		template<typename T>
+		T getNumber(size_t column) const
+		{
+			return static_cast<T>(getInteger(column));
+		}
+
+		std::string getString(size_t column) const;
+		const char* getStream(size_t column, unsigned long& size) const;
+
+		bool hasNext() const {
+			return hasRow;
+		}
+		bool next();
+
+	private:
+		DBStatement(Database& db, DBPreparedStatement* prepared);
+
+		void bindInteger(uint64_t value, bool isUnsigned);
+		int64_t getInteger(size_t column) const;
+
+		std::unique_lock<std::recursive_mutex> lock;
+		Database* db;
+		DBPreparedStatement* prepared;
+		size_t paramIndex = 0;
+		bool hasRow = false;
+
+	friend class Database;
 };
 
 class DBResult
 {
 	public:
-		explicit DBResult(MYSQL_RES* res);
+		static constexpr size_t INVALID_COLUMN = std::numeric_limits<size_t>::max();
+
+		DBResult(MYSQL_RES* res, MYSQL* connection, std::unique_lock<std::recursive_mutex>&& lock);
 		~DBResult();
 
 		// non-copyable
 		DBResult(const DBResult&) = delete;
 		DBResult& operator=(const DBResult&) = delete;
 
+		/**
+		 * Resolves a column name to the index the accessors below take,
+		 * loops over many rows should do this once before the first row.
+		 *
+		 * @return column index, INVALID_COLUMN if there is no such column
+		 */
+		size_t getColumn(const std::string& s) const;
+
 		template<typename T>
-		T getNumber(const std::string& s) const
+		T getNumber(size_t column) const
 		{
-			auto it = listNames.find(s);
-			if (it == listNames.end()) {
-				std::cout << "[Error - DBResult::getNumber] Column '" << s << "' doesn't exist in the result set" << std::endl;
-				return static_cast<T>(0);
-			}
-
-			if (row[it->second] == nullptr) {
+			const char* value = getValue(column, "getNumber");
+			if (value == nullptr) {
 				return static_cast<T>(0);
 			}
+			return parseNumber<T>(value);
+		}
 
-			T data;
-			try {
-				data = boost::lexical_cast<T>(row[it->second]);
-			} catch (boost::bad_lexical_cast&) {
-				data = 0;
-			}
-			return data;
+		template<typename T>
+		T getNumber(const std::string& s) const
+		{
+			return getNumber<T>(getNamedColumn(s, "getNumber"));
 		}
 
+		std::string getString(size_t column) const;
 		std::string getString(const std::string& s) const;
+
+		// points into the row, valid until the next call to next()
+		const char* getStream(size_t column, unsigned long& size) const;
 		const char* getStream(const std::string& s, unsigned long& size) const;
 
 		bool hasNext() const;
 		bool next();
 
 	private:
+		template<typename T>
+		static typename std::enable_if<std::is_signed<T>::value, T>::type parseNumber(const char* value)
+		{
+			return static_cast<T>(std::strtoll(value, nullptr, 10));
+		}
+
+		template<typename T>
+		static typename std::enable_if<!std::is_signed<T>::value, T>::type parseNumber(const char* value)
+		{
+			return static_cast<T>(std::strtoull(value, nullptr, 10));
+		}
+
+		size_t getNamedColumn(const std::string& s, const char* caller) const;
+		const char* getValue(size_t column, const char* caller) const;
+
+		std::unique_lock<std::recursive_mutex> lock; // held by streamed results only
 		MYSQL_RES* handle;
+		MYSQL* connection;
 		MYSQL_ROW row;
-
-		std::map<std::string, size_t> listNames;
+		MYSQL_FIELD* fields;
+		size_t fieldCount;
 
 	friend class Database;
 };
@@ -191,6 +326,10 @@ class DBInsert
 {
 	public:
 		explicit DBInsert(const std::string& query);
+
+		// rows whose key already exists update these columns instead of failing
+		void upsert(const std::vector<std::string>& columns);
+
 		bool addRow(const std::string& row);
 		bool addRow(std::ostringstream& row);
 		bool execute();
@@ -198,6 +337,7 @@ class DBInsert
 	private:
 		std::string query;
 		std::string values;
+		std::string upsertClause;
 		size_t length;
 };
 
@@ -62,6 +62,15 @@ bool DatabaseManager::tableExists(const std::string& tableName)
 	return db.storeQuery(query.str()).get() != nullptr;
 }
 
+bool DatabaseManager::columnExists(const std::string& tableName, const std::string& columnName)
+{
+	Database& db = Database::getInstance();
+
+	std::ostringstream query;
+	query << "SELECT `COLUMN_NAME` FROM `information_schema`.`columns` WHERE `TABLE_SCHEMA` = " << db.escapeString(g_config.getString(ConfigManager::MYSQL_DB)) << " AND `TABLE_NAME` = " << db.escapeString(tableName) << " AND `COLUMN_NAME` = " << db.escapeString(columnName) << " LIMIT 1";
+	return db.storeQuery(query.str()).get() != nullptr;
+}
+
 bool DatabaseManager::isDatabaseSetup()
 {
 	Database& db = Database::getInstance();
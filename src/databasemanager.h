@@ -26,6 +26,7 @@ class DatabaseManager
 {
 	public:
 		static bool tableExists(const std::string& tableName);
+		static bool columnExists(const std::string& tableName, const std::string& columnName);
 
 		static int32_t getDatabaseVersion();
 		static bool isDatabaseSetup();
@@ -22,43 +22,103 @@
 
 #include "databasetasks.h"
 #include "tasks.h"
+#include "tools.h"
 
 extern Dispatcher g_dispatcher;
 
 
-void DatabaseTasks::start()
+bool DatabaseTasks::start(size_t threadCount)
 {
-	db.connect();
-	ThreadHolder::start();
+	threadCount = std::max<size_t>(1, threadCount);
+	for (size_t i = 0; i < threadCount; ++i) {
+		std::unique_ptr<Database> db(new Database);
+		if (!db->connect()) {
+			return false;
+		}
+		connections.push_back(std::move(db));
+	}
+
+	threadState = THREAD_STATE_RUNNING;
+	for (const auto& db : connections) {
+		threads.emplace_back(&DatabaseTasks::threadMain, this, db.get());
+	}
+	return true;
 }
 
-void DatabaseTasks::threadMain()
+void DatabaseTasks::threadMain(Database* db)
 {
-	std::unique_lock<std::mutex> taskLockUnique(taskLock, std::defer_lock);
-	while (getState() != THREAD_STATE_TERMINATED) {
-		taskLockUnique.lock();
-		if (tasks.empty()) {
-			taskSignal.wait(taskLockUnique);
+	Database::setThreadInstance(db);
+
+	std::unique_lock<std::mutex> taskLockUnique(taskLock);
+	while (true) {
+		taskSignal.wait(taskLockUnique, [this]() { return !readyKeys.empty() || threadState == THREAD_STATE_TERMINATED; });
+		if (readyKeys.empty()) {
+			// terminated and drained
+			break;
 		}
 
-		if (!tasks.empty()) {
-			DatabaseTask task = std::move(tasks.front());
-			tasks.pop_front();
-			taskLockUnique.unlock();
-			runTask(task);
+		uint64_t key = readyKeys.front();
+		readyKeys.pop_front();
+
+		TaskQueue& queue = queues[key];
+		DatabaseTask task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		queue.running = true;
+		--queuedTasks;
+		++runningTasks;
+		taskLockUnique.unlock();
+
+		runTask(*db, task);
+
+		taskLockUnique.lock();
+		int64_t latency = OTSYS_TIME() - task.queuedAt;
+		totalLatency += latency;
+		maxLatency = std::max(maxLatency, latency);
+		++executedTasks;
+		--runningTasks;
+
+		// references into queues survive the insertions made meanwhile
+		queue.running = false;
+		if (queue.tasks.empty()) {
+			queues.erase(key);
 		} else {
-			taskLockUnique.unlock();
+			readyKeys.push_back(key);
+			taskSignal.notify_one();
+		}
+
+		if (queuedTasks == 0 && runningTasks == 0) {
+			flushSignal.notify_all();
 		}
 	}
+
+	Database::setThreadInstance(nullptr);
+}
+
+void DatabaseTasks::addTask(std::string query, std::function<void(DBResult_ptr, bool)> callback/* = nullptr*/, bool store/* = false*/, uint64_t orderKey/* = 0*/)
+{
+	enqueue(DatabaseTask(std::move(query), std::move(callback), store), orderKey);
+}
+
+void DatabaseTasks::addWork(std::function<void(void)> work, uint64_t orderKey/* = 0*/)
+{
+	enqueue(DatabaseTask(std::move(work)), orderKey);
 }
 
-void DatabaseTasks::addTask(std::string query, std::function<void(DBResult_ptr, bool)> callback/* = nullptr*/, bool store/* = false*/)
+void DatabaseTasks::enqueue(DatabaseTask&& task, uint64_t orderKey)
 {
 	bool signal = false;
 	taskLock.lock();
-	if (getState() == THREAD_STATE_RUNNING) {
-		signal = tasks.empty();
-		tasks.emplace_back(std::move(query), std::move(callback), store);
+	if (threadState == THREAD_STATE_RUNNING) {
+		TaskQueue& queue = queues[orderKey];
+		queue.tasks.push_back(std::move(task));
+		queue.tasks.back().queuedAt = OTSYS_TIME();
+		++queuedTasks;
+
+		// a key is ready when it has tasks and no worker is running one of them
+		if (!queue.running && queue.tasks.size() == 1) {
+			readyKeys.push_back(orderKey);
+			signal = true;
+		}
 	}
 	taskLock.unlock();
 
@@ -67,8 +127,13 @@ void DatabaseTasks::addTask(std::string query, std::function<void(DBResult_ptr,
 	}
 }
 
-void DatabaseTasks::runTask(const DatabaseTask& task)
+void DatabaseTasks::runTask(Database& db, const DatabaseTask& task)
 {
+	if (task.work) {
+		task.work();
+		return;
+	}
+
 	bool success;
 	DBResult_ptr result;
 	if (task.store) {
@@ -87,20 +152,49 @@ void DatabaseTasks::runTask(const DatabaseTask& task)
 void DatabaseTasks::flush()
 {
 	std::unique_lock<std::mutex> guard{ taskLock };
-	while (!tasks.empty()) {
-		auto task = std::move(tasks.front());
-		tasks.pop_front();
-		guard.unlock();
-		runTask(task);
-		guard.lock();
+	if (threads.empty()) {
+		return;
+	}
+
+	flushSignal.wait(guard, [this]() { return queuedTasks == 0 && runningTasks == 0; });
+}
+
+void DatabaseTasks::stop()
+{
+	taskLock.lock();
+	if (threadState == THREAD_STATE_RUNNING) {
+		threadState = THREAD_STATE_CLOSING;
 	}
+	taskLock.unlock();
 }
 
 void DatabaseTasks::shutdown()
 {
 	taskLock.lock();
-	setState(THREAD_STATE_TERMINATED);
+	threadState = THREAD_STATE_TERMINATED;
 	taskLock.unlock();
+	taskSignal.notify_all();
 	flush();
-	taskSignal.notify_one();
+}
+
+void DatabaseTasks::join()
+{
+	for (std::thread& thread : threads) {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+}
+
+DatabaseTaskStats DatabaseTasks::getStats()
+{
+	std::lock_guard<std::mutex> lockClass(taskLock);
+
+	DatabaseTaskStats stats;
+	stats.queued = queuedTasks;
+	stats.running = runningTasks;
+	stats.executed = executedTasks;
+	stats.averageLatency = executedTasks != 0 ? totalLatency / static_cast<int64_t>(executedTasks) : 0;
+	stats.maxLatency = maxLatency;
+	return stats;
 }
@@ -22,38 +22,89 @@
 #define FS_DATABASETASKS_H_9CBA08E9F5FEBA7275CCEE6560059576
 
 #include <condition_variable>
-#include "thread_holder_base.h"
 #include "database.h"
 #include "enums.h"
 
 struct DatabaseTask {
 	DatabaseTask(std::string&& query, std::function<void(DBResult_ptr, bool)>&& callback, bool store) :
 		query(std::move(query)), callback(std::move(callback)), store(store) {}
+	explicit DatabaseTask(std::function<void(void)>&& work) : work(std::move(work)), store(false) {}
 
 	std::string query;
 	std::function<void(DBResult_ptr, bool)> callback;
+	std::function<void(void)> work;
 	bool store;
+	int64_t queuedAt = 0;
 };
 
-class DatabaseTasks : public ThreadHolder<DatabaseTasks>
+// ordering keys of the non-player tasks, players are ordered by their guid
+static constexpr uint64_t DATABASE_ORDER_POKEMON = 1ULL << 32; // | pokemon guid
+static constexpr uint64_t DATABASE_ORDER_HOUSES = 2ULL << 32;
+static constexpr uint64_t DATABASE_ORDER_JOURNAL = 3ULL << 32;
+static constexpr uint64_t DATABASE_ORDER_MARKET = 4ULL << 32;
+
+struct DatabaseTaskStats {
+	size_t queued = 0;
+	size_t running = 0;
+	uint64_t executed = 0;
+	int64_t averageLatency = 0;
+	int64_t maxLatency = 0;
+};
+
+/**
+ * Runs queries asynchronously on a pool of connections. Tasks that share
+ * an ordering key (player guid, house id) run in the order they were
+ * added, tasks with different keys run in parallel. Tasks added without
+ * a key share the default key 0 and stay ordered among themselves.
+ */
+class DatabaseTasks
 {
 	public:
 		DatabaseTasks() = default;
-		void start();
+
+		// non-copyable
+		DatabaseTasks(const DatabaseTasks&) = delete;
+		DatabaseTasks& operator=(const DatabaseTasks&) = delete;
+
+		bool start(size_t threadCount);
+		void stop();
 		void flush();
 		void shutdown();
+		void join();
+
+		void addTask(std::string query, std::function<void(DBResult_ptr, bool)> callback = nullptr, bool store = false, uint64_t orderKey = 0);
+
+		// runs arbitrary database work, Database::getInstance() returns the worker's connection
+		void addWork(std::function<void(void)> work, uint64_t orderKey = 0);
 
-		void addTask(std::string query, std::function<void(DBResult_ptr, bool)> callback = nullptr, bool store = false);
+		DatabaseTaskStats getStats();
 
-		void threadMain();
 	private:
-		void runTask(const DatabaseTask& task);
+		struct TaskQueue {
+			std::list<DatabaseTask> tasks;
+			bool running = false;
+		};
 
-		Database db;
-		std::thread thread;
-		std::list<DatabaseTask> tasks;
+		void threadMain(Database* db);
+		void enqueue(DatabaseTask&& task, uint64_t orderKey);
+		void runTask(Database& db, const DatabaseTask& task);
+
+		std::vector<std::unique_ptr<Database>> connections;
+		std::vector<std::thread> threads;
+
+		std::unordered_map<uint64_t, TaskQueue> queues;
+		std::list<uint64_t> readyKeys;
 		std::mutex taskLock;
 		std::condition_variable taskSignal;
+		std::condition_variable flushSignal;
+		ThreadState threadState = THREAD_STATE_TERMINATED;
+
+		// guarded by taskLock
+		size_t queuedTasks = 0;
+		size_t runningTasks = 0;
+		uint64_t executedTasks = 0;
+		int64_t totalLatency = 0;
+		int64_t maxLatency = 0;
 };
 
 extern DatabaseTasks g_databaseTasks;
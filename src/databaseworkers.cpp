@@ -0,0 +1,96 @@
+/**
+ * The Ruby Server - a free and open-source Pokémon MMORPG server emulator
+ * Copyright (C) 2018  Mark Samman (TFS) <mark.samman@gmail.com>
+ *                     Leandro Matheus <kesuhige@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "otpch.h"
+
+#include "databaseworkers.h"
+
+bool DatabaseWorkers::start(size_t threadCount)
+{
+	threadCount = std::max<size_t>(1, threadCount);
+	for (size_t i = 0; i < threadCount; ++i) {
+		std::unique_ptr<Database> db(new Database);
+		if (!db->connect()) {
+			return false;
+		}
+		connections.push_back(std::move(db));
+	}
+
+	threadState = THREAD_STATE_RUNNING;
+	for (const auto& db : connections) {
+		threads.emplace_back(&DatabaseWorkers::threadMain, this, db.get());
+	}
+	return true;
+}
+
+void DatabaseWorkers::threadMain(Database* db)
+{
+	Database::setThreadInstance(db);
+
+	std::unique_lock<std::mutex> taskLockUnique(taskLock);
+	while (true) {
+		taskSignal.wait(taskLockUnique, [this]() { return !tasks.empty() || threadState != THREAD_STATE_RUNNING; });
+		if (threadState != THREAD_STATE_RUNNING) {
+			break;
+		}
+
+		auto task = std::move(tasks.front());
+		tasks.pop_front();
+		taskLockUnique.unlock();
+		task();
+		taskLockUnique.lock();
+	}
+
+	Database::setThreadInstance(nullptr);
+}
+
+void DatabaseWorkers::addTask(std::function<void(void)> task)
+{
+	// every task wakes a worker, idle ones may be waiting while others are busy
+	bool signal = false;
+	taskLock.lock();
+	if (threadState == THREAD_STATE_RUNNING) {
+		signal = true;
+		tasks.emplace_back(std::move(task));
+	}
+	taskLock.unlock();
+
+	if (signal) {
+		taskSignal.notify_one();
+	}
+}
+
+void DatabaseWorkers::shutdown()
+{
+	taskLock.lock();
+	threadState = THREAD_STATE_TERMINATED;
+	tasks.clear();
+	taskLock.unlock();
+	taskSignal.notify_all();
+}
+
+void DatabaseWorkers::join()
+{
+	for (std::thread& thread : threads) {
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+}
@@ -0,0 +1,61 @@
+/**
+ * The Ruby Server - a free and open-source Pokémon MMORPG server emulator
+ * Copyright (C) 2018  Mark Samman (TFS) <mark.samman@gmail.com>
+ *                     Leandro Matheus <kesuhige@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FS_DATABASEWORKERS_H_6A1F0C2D8B3E4F5A9C7D1E2B3A4F5C6D
+#define FS_DATABASEWORKERS_H_6A1F0C2D8B3E4F5A9C7D1E2B3A4F5C6D
+
+#include <condition_variable>
+#include "database.h"
+#include "enums.h"
+
+/**
+ * Runs blocking database work (login, character loading) away from the
+ * dispatcher. Every worker thread owns a connection which
+ * Database::getInstance() returns while running on that thread.
+ */
+class DatabaseWorkers
+{
+	public:
+		DatabaseWorkers() = default;
+
+		// non-copyable
+		DatabaseWorkers(const DatabaseWorkers&) = delete;
+		DatabaseWorkers& operator=(const DatabaseWorkers&) = delete;
+
+		bool start(size_t threadCount);
+		void shutdown();
+		void join();
+
+		void addTask(std::function<void(void)> task);
+
+	private:
+		void threadMain(Database* db);
+
+		std::vector<std::unique_ptr<Database>> connections;
+		std::vector<std::thread> threads;
+		std::list<std::function<void(void)>> tasks;
+		std::mutex taskLock;
+		std::condition_variable taskSignal;
+		ThreadState threadState = THREAD_STATE_TERMINATED;
+};
+
+extern DatabaseWorkers g_databaseWorkers;
+
+#endif
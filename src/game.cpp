@@ -28,12 +28,14 @@
 #include "creature.h"
 #include "creatureevent.h"
 #include "databasetasks.h"
+#include "databaseworkers.h"
 #include "events.h"
 #include "game.h"
 #include "globalevent.h"
 #include "iologindata.h"
 #include "iomarket.h"
 #include "items.h"
+#include "journal.h"
 #include "pokemon.h"
 #include "movement.h"
 #include "scheduler.h"
@@ -59,6 +61,19 @@ extern MoveEvents* g_moveEvents;
 extern Pokeballs* g_pokeballs;
 extern Foods* g_foods;
 
+template <typename CreatureType>
+static bool eraseMappedName(std::unordered_multimap<std::string, CreatureType*>& mappedNames, CreatureType* creature)
+{
+	auto range = mappedNames.equal_range(asLowerCaseString(creature->getName()));
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == creature) {
+			mappedNames.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
 Game::Game()
 {
 	//
@@ -77,6 +92,10 @@ void Game::start(ServiceManager* manager)
 
 	g_scheduler.addEvent(createSchedulerTask(EVENT_CREATURE_THINK_INTERVAL, std::bind(&Game::checkCreatures, this, 0)));
 	g_scheduler.addEvent(createSchedulerTask(EVENT_DECAYINTERVAL, std::bind(&Game::checkDecay, this)));
+	g_scheduler.addEvent(createSchedulerTask(EVENT_ROLLINGSAVEINTERVAL, std::bind(&Game::checkRollingSave, this)));
+	if (g_journal.isStarted()) {
+		g_scheduler.addEvent(createSchedulerTask(EVENT_JOURNALINTERVAL_MIN, std::bind(&Game::checkJournal, this)));
+	}
 }
 
 GameState_t Game::getGameState() const
@@ -126,10 +145,8 @@ void Game::setGameState(GameState_t newState)
 			g_globalEvents->execute(GLOBALEVENT_SHUTDOWN);
 
 			//kick all players that are still online
-			auto it = players.begin();
-			while (it != players.end()) {
-				it->second->kickPlayer(true);
-				it = players.begin();
+			while (!players.empty()) {
+				(*players.begin())->kickPlayer(true);
 			}
 
 			saveGameState();
@@ -147,8 +164,8 @@ void Game::setGameState(GameState_t newState)
 			/* kick all players without the CanAlwaysLogin flag */
 			auto it = players.begin();
 			while (it != players.end()) {
-				if (!it->second->hasFlag(PlayerFlag_CanAlwaysLogin)) {
-					it->second->kickPlayer(true);
+				if (!(*it)->hasFlag(PlayerFlag_CanAlwaysLogin)) {
+					(*it)->kickPlayer(true);
 					it = players.begin();
 				} else {
 					++it;
@@ -164,45 +181,126 @@ void Game::setGameState(GameState_t newState)
 	}
 }
 
-void Game::saveGameState()
+namespace {
+
+// reports a world save once the last of its background writes lets go of it
+class WorldSaveProgress
 {
-	if (gameState == GAME_STATE_NORMAL) {
-		setGameState(GAME_STATE_MAINTAIN);
-	}
+	public:
+		WorldSaveProgress() : start(OTSYS_TIME()) {}
+		~WorldSaveProgress() {
+			std::cout << "> World save written in: " << (OTSYS_TIME() - start) / (1000.) << " s";
+			if (failed) {
+				std::cout << ", some writes failed";
+			}
+			std::cout << std::endl;
+		}
+
+		void done(bool saved) {
+			if (!saved) {
+				failed = true;
+			}
+		}
 
+	private:
+		int64_t start;
+		std::atomic<bool> failed{false};
+};
+
+}
+
+void Game::saveGameState()
+{
 	std::cout << "Saving server..." << std::endl;
 
+	// only the copying happens here, the writes run on the database task
+	// threads while the world keeps going
 	int64_t start = OTSYS_TIME();
-	int64_t count = players.size();
+	auto progress = std::make_shared<WorldSaveProgress>();
+	auto callback = [progress](bool saved) { progress->done(saved); };
 
-	for (const auto& it : players) {
-		it.second->loginPosition = it.second->getPosition();
-		IOLoginData::savePlayer(it.second);
+	size_t playerCount = 0;
+	for (Player* player : players) {
+		player->loginPosition = player->getPosition();
+		if (IOLoginData::savePlayerAsync(player, callback)) {
+			++playerCount;
+		}
 	}
 
-	std::cout << "> Saved " << count << " players in: " <<
-	          (OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
-	
-	start = OTSYS_TIME();
-	count = 0;
+	std::vector<Pokemon*> storedPokemons;
+	storedPokemons.reserve(pokemons.size());
+	for (Pokemon* pokemon : pokemons) {
+		if (pokemon->getGUID() != 0) {
+			storedPokemons.push_back(pokemon);
+		}
+	}
 
-	for (const auto& it : pokemons) {
-		if (it.second->getGUID() != 0) {
-			IOLoginData::savePokemon(it.second);
-			count++;
-		}		
+	if (!IOLoginData::savePokemonsAsync(storedPokemons, callback)) {
+		storedPokemons.clear();
 	}
 
-	std::cout << "> Saved " << count << " pokemon in: " <<
+	Map::save(callback);
+
+	std::cout << "> Copied " << playerCount << " players and " << storedPokemons.size() << " pokemon in: " <<
 	          (OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
+}
+
+void Game::checkRollingSave()
+{
+	g_scheduler.addEvent(createSchedulerTask(EVENT_ROLLINGSAVEINTERVAL, std::bind(&Game::checkRollingSave, this)));
+
+	int64_t window = static_cast<int64_t>(g_config.getNumber(ConfigManager::ROLLING_SAVE_WINDOW)) * 1000;
+	if (window <= 0 || gameState != GAME_STATE_NORMAL) {
+		return;
+	}
+
+	std::vector<std::pair<int64_t, Creature*>> candidates;
+	candidates.reserve(players.size() + pokemons.size());
+	for (Player* player : players) {
+		candidates.emplace_back(player->lastSaveTime, player);
+	}
+	for (Pokemon* pokemon : pokemons) {
+		// wild pokemon are never stored
+		if (pokemon->getGUID() != 0) {
+			candidates.emplace_back(pokemon->lastSaveTime, pokemon);
+		}
+	}
+
+	// spreading everyone evenly over the window saves each of them once per window
+	size_t budget = (candidates.size() * EVENT_ROLLINGSAVEINTERVAL + window - 1) / window;
+	if (budget == 0) {
+		return;
+	}
+
+	if (budget < candidates.size()) {
+		std::nth_element(candidates.begin(), candidates.begin() + budget, candidates.end(),
+			[](const std::pair<int64_t, Creature*>& lhs, const std::pair<int64_t, Creature*>& rhs) { return lhs.first < rhs.first; });
+		candidates.resize(budget);
+	}
 
-	Map::save();
+	std::vector<Pokemon*> duePokemons;
+	for (const auto& it : candidates) {
+		if (Player* player = it.second->getPlayer()) {
+			player->loginPosition = player->getPosition();
+			IOLoginData::savePlayerAsync(player);
+		} else {
+			duePokemons.push_back(it.second->getPokemon());
+		}
+	}
+	IOLoginData::savePokemonsAsync(duePokemons);
+}
 
-	g_databaseTasks.flush();
+void Game::checkJournal()
+{
+	int32_t interval = std::max<int32_t>(EVENT_JOURNALINTERVAL_MIN, g_config.getNumber(ConfigManager::JOURNAL_INTERVAL));
+	g_scheduler.addEvent(createSchedulerTask(interval, std::bind(&Game::checkJournal, this)));
 
-	if (gameState == GAME_STATE_MAINTAIN) {
-		setGameState(GAME_STATE_NORMAL);
+	for (Player* player : players) {
+		IOLoginData::journalPlayer(player);
 	}
+
+	// one fsync for everything since the last check
+	g_databaseTasks.addWork([]() { g_journal.sync(); }, DATABASE_ORDER_JOURNAL);
 }
 
 bool Game::loadMainMap(const std::string& filename)
@@ -375,78 +473,179 @@ void Game::internalGetPosition(Item* item, Position& pos, uint8_t& stackpos)
 
 Creature* Game::getCreatureByID(uint32_t id)
 {
-	if (id <= Player::playerAutoID) {
-		return getPlayerByID(id);
-	} else if (id <= Pokemon::pokemonAutoID) {
-		return getPokemonByID(id);
-	} else if (id <= Npc::npcAutoID) {
-		return getNpcByID(id);
+	if (players.contains(id)) {
+		return players.get(id);
+	} else if (pokemons.contains(id)) {
+		return pokemons.get(id);
+	}
+	return npcs.get(id);
+}
+
+uint32_t Game::reserveCreatureID(CreatureType_t type)
+{
+	switch (type) {
+		case CREATURETYPE_PLAYER: return players.reserve();
+		case CREATURETYPE_NPC: return npcs.reserve();
+		default: return pokemons.reserve();
+	}
+}
+
+void Game::releaseCreatureID(uint32_t id)
+{
+	if (players.contains(id)) {
+		players.release(id);
+	} else if (pokemons.contains(id)) {
+		pokemons.release(id);
+	} else {
+		npcs.release(id);
 	}
-	return nullptr;
 }
 
 Pokemon* Game::getPokemonByID(uint32_t id)
 {
-	if (id == 0) {
+	return pokemons.get(id);
+}
+
+Pokemon* Game::getPokemonByGUID(const uint32_t& guid)
+{
+	if (guid == 0) {
 		return nullptr;
 	}
 
-	auto it = pokemons.find(id);
-	if (it == pokemons.end()) {
+	if (Pokemon* pokemon = getLoadedPokemonByGUID(guid)) {
+		return pokemon;
+	}
+
+	// never wait for the database here, the next use finds it loaded
+	loadPokemons({guid});
+	return nullptr;
+}
+
+Pokemon* Game::getLoadedPokemonByGUID(uint32_t guid)
+{
+	auto it = loadedPokemons.find(guid);
+	if (it == loadedPokemons.end()) {
 		return nullptr;
 	}
 	return it->second;
 }
 
-Pokemon* Game::getPokemonByGUID(const uint32_t& guid)
+void Game::addLoadedPokemons(const std::vector<Pokemon*>& loaded)
 {
-	if (guid == 0) {
-		return nullptr;
+	for (Pokemon* pokemon : loaded) {
+		if (loadedPokemons.find(pokemon->getGUID()) != loadedPokemons.end()) {
+			// loaded twice meanwhile, the one in use stays
+			delete pokemon;
+			continue;
+		}
+
+		pokemon->incrementReferenceCounter();
+		pokemon->setID();
+		pokemon->addList();
+		pokemon->setDropLoot(false);
+		pokemon->persistent = true;
+		loadedPokemons[pokemon->getGUID()] = pokemon;
 	}
+}
 
-	for (const auto& it : pokemons) {
-		if (guid == it.second->getGUID()) {
-			return it.second;
+void Game::loadPokemons(const std::vector<uint32_t>& guids)
+{
+	std::vector<uint32_t> missing;
+	for (uint32_t guid : guids) {
+		if (guid != 0 && loadedPokemons.find(guid) == loadedPokemons.end() && loadingPokemons.insert(guid).second) {
+			missing.push_back(guid);
 		}
 	}
 
-	Pokemon* pokemon = new Pokemon();
-	if (!IOLoginData::loadPokemonById(pokemon, guid)) {
-		delete pokemon;
-		return nullptr;
+	if (missing.empty()) {
+		return;
 	}
 
-	pokemon->incrementReferenceCounter();
-	pokemon->setID();
-	pokemon->addList();
-	pokemon->setDropLoot(false);
-	return pokemon;
+	// after any save of them that is still being written
+	g_databaseTasks.addWork([missing]() {
+		//database task thread
+		auto loaded = std::make_shared<std::vector<Pokemon*>>();
+		IOLoginData::loadPokemonsById(missing, *loaded);
+
+		g_dispatcher.addTask(createTask([missing, loaded]() {
+			for (uint32_t guid : missing) {
+				g_game.loadingPokemons.erase(guid);
+			}
+			g_game.addLoadedPokemons(*loaded);
+
+			for (uint32_t guid : missing) {
+				auto it = g_game.loadingPokemonCallbacks.find(guid);
+				if (it == g_game.loadingPokemonCallbacks.end()) {
+					continue;
+				}
+
+				std::vector<std::function<void(Pokemon*)>> callbacks = std::move(it->second);
+				g_game.loadingPokemonCallbacks.erase(it);
+
+				Pokemon* pokemon = g_game.getLoadedPokemonByGUID(guid);
+				for (const auto& callback : callbacks) {
+					callback(pokemon);
+				}
+			}
+		}));
+	}, DATABASE_ORDER_POKEMON);
 }
 
-Npc* Game::getNpcByID(uint32_t id)
+void Game::loadPokemon(uint32_t guid, std::function<void(Pokemon*)> callback)
 {
-	if (id == 0) {
-		return nullptr;
+	if (guid == 0) {
+		callback(nullptr);
+		return;
 	}
 
-	auto it = npcs.find(id);
-	if (it == npcs.end()) {
-		return nullptr;
+	if (Pokemon* pokemon = getLoadedPokemonByGUID(guid)) {
+		callback(pokemon);
+		return;
 	}
-	return it->second;
+
+	loadingPokemonCallbacks[guid].push_back(std::move(callback));
+	loadPokemons({guid});
 }
 
-Player* Game::getPlayerByID(uint32_t id)
+void Game::unloadPokemons(uint32_t ownerGuid, const std::vector<uint32_t>& guids)
 {
-	if (id == 0) {
-		return nullptr;
+	if (getPlayerByGUID(ownerGuid)) {
+		// logged in again, their next logout tries again
+		return;
 	}
 
-	auto it = players.find(id);
-	if (it == players.end()) {
-		return nullptr;
+	std::vector<Pokemon*> unloaded;
+	for (uint32_t guid : guids) {
+		Pokemon* pokemon = getLoadedPokemonByGUID(guid);
+		if (pokemon && !pokemon->getParent()) {
+			unloaded.push_back(pokemon);
+		}
 	}
-	return it->second;
+
+	if (unloaded.empty()) {
+		return;
+	}
+
+	// what gets written is copied right away, so they can go right after
+	IOLoginData::savePokemonsAsync(unloaded);
+
+	for (Pokemon* pokemon : unloaded) {
+		loadedPokemons.erase(pokemon->getGUID());
+		if (pokemons.erase(pokemon)) {
+			eraseMappedName(mappedPokemonNames, pokemon);
+		}
+		pokemon->decrementReferenceCounter();
+	}
+}
+
+Npc* Game::getNpcByID(uint32_t id)
+{
+	return npcs.get(id);
+}
+
+Player* Game::getPlayerByID(uint32_t id)
+{
+	return players.get(id);
 }
 
 Creature* Game::getCreatureByName(const std::string& s)
@@ -462,16 +661,14 @@ Creature* Game::getCreatureByName(const std::string& s)
 		return m_it->second;
 	}
 
-	for (const auto& it : npcs) {
-		if (lowerCaseName == asLowerCaseString(it.second->getName())) {
-			return it.second;
-		}
+	auto npc_it = mappedNpcNames.find(lowerCaseName);
+	if (npc_it != mappedNpcNames.end()) {
+		return npc_it->second;
 	}
 
-	for (const auto& it : pokemons) {
-		if (lowerCaseName == asLowerCaseString(it.second->getName())) {
-			return it.second;
-		}
+	auto pokemon_it = mappedPokemonNames.find(lowerCaseName);
+	if (pokemon_it != mappedPokemonNames.end()) {
+		return pokemon_it->second;
 	}
 	return nullptr;
 }
@@ -482,13 +679,11 @@ Npc* Game::getNpcByName(const std::string& s)
 		return nullptr;
 	}
 
-	const char* npcName = s.c_str();
-	for (const auto& it : npcs) {
-		if (strcasecmp(npcName, it.second->getName().c_str()) == 0) {
-			return it.second;
-		}
+	auto it = mappedNpcNames.find(asLowerCaseString(s));
+	if (it == mappedNpcNames.end()) {
+		return nullptr;
 	}
-	return nullptr;
+	return it->second;
 }
 
 Player* Game::getPlayerByName(const std::string& s)
@@ -510,12 +705,11 @@ Player* Game::getPlayerByGUID(const uint32_t& guid)
 		return nullptr;
 	}
 
-	for (const auto& it : players) {
-		if (guid == it.second->getGUID()) {
-			return it.second;
-		}
+	auto it = mappedPlayerGuids.find(guid);
+	if (it == mappedPlayerGuids.end()) {
+		return nullptr;
 	}
-	return nullptr;
+	return it->second;
 }
 
 ReturnValue Game::getPlayerByNameWildcard(const std::string& s, Player*& player)
@@ -547,9 +741,9 @@ ReturnValue Game::getPlayerByNameWildcard(const std::string& s, Player*& player)
 
 Player* Game::getPlayerByAccount(uint32_t acc)
 {
-	for (const auto& it : players) {
-		if (it.second->getAccount() == acc) {
-			return it.second;
+	for (Player* player : players) {
+		if (player->getAccount() == acc) {
+			return player;
 		}
 	}
 	return nullptr;
@@ -1923,8 +2117,8 @@ bool Game::playerBroadcastMessage(Player* player, const std::string& text) const
 
 	std::cout << "> " << player->getName() << " broadcasted: \"" << text << "\"." << std::endl;
 
-	for (const auto& it : players) {
-		it.second->sendPrivateMessage(player, TALKTYPE_BROADCAST, text);
+	for (Player* receiver : players) {
+		receiver->sendPrivateMessage(player, TALKTYPE_BROADCAST, text);
 	}
 
 	return true;
@@ -2558,6 +2752,10 @@ void Game::playerWriteItem(uint32_t playerId, uint32_t windowTextId, const std::
 		writeItem->resetDate();
 	}
 
+	if (HouseTile* houseTile = dynamic_cast<HouseTile*>(writeItem->getTile())) {
+		houseTile->getHouse()->setItemsChanged(true);
+	}
+
 	uint16_t newId = Item::items[writeItem->getID()].writeOnceItemId;
 	if (newId != 0) {
 		transformItem(writeItem, newId);
@@ -3843,6 +4041,17 @@ void Game::internalCreatureChangeVisible(Creature* creature, bool visible)
 
 void Game::internalCreatureChangeName(Creature* creature, const std::string& name)
 {
+	// keep the name indexes in step, players can not be renamed while online
+	if (Npc* npc = creature->getNpc()) {
+		if (eraseMappedName(mappedNpcNames, npc)) {
+			mappedNpcNames.emplace(asLowerCaseString(name), npc);
+		}
+	} else if (Pokemon* pokemon = creature->getPokemon()) {
+		if (eraseMappedName(mappedPokemonNames, pokemon)) {
+			mappedPokemonNames.emplace(asLowerCaseString(name), pokemon);
+		}
+	}
+
 	creature->setName(name);
 
 	//send to clients
@@ -4512,8 +4721,8 @@ void Game::checkLight()
 			lightHour = gameHour;
 			LightInfo lightInfo = getWorldLightInfo();
 
-			for (const auto& it : players) {
-				it.second->sendWorldLight(lightInfo);
+			for (Player* player : players) {
+				player->sendWorldLight(lightInfo);
 			}
 		}
 	}
@@ -4530,7 +4739,9 @@ void Game::shutdown()
 
 	g_scheduler.shutdown();
 	g_databaseTasks.shutdown();
+	g_databaseWorkers.shutdown();
 	g_dispatcher.shutdown();
+	g_journal.close();
 	map.spawns.clear();
 	raids.clear();
 
@@ -4584,8 +4795,8 @@ void Game::ReleaseItem(Item* item)
 void Game::broadcastMessage(const std::string& text, MessageClasses type) const
 {
 	std::cout << "> Broadcasted message: \"" << text << "\"." << std::endl;
-	for (const auto& it : players) {
-		it.second->sendTextMessage(type, text);
+	for (Player* player : players) {
+		player->sendTextMessage(type, text);
 	}
 }
 
@@ -5154,7 +5365,7 @@ void Game::playerCreateMarketOffer(uint32_t playerId, uint8_t type, uint16_t spr
 		player->bankBalance -= totalPrice;
 	}
 
-	IOMarket::createOffer(player->getGUID(), static_cast<MarketAction_t>(type), it.id, amount, price, anonymous);
+	IOMarket::createOffer(player->getGUID(), player->getName(), static_cast<MarketAction_t>(type), it.id, amount, price, anonymous);
 
 	player->sendMarketEnter(player->getLastDepotId());
 	const MarketOfferList& buyOffers = IOMarket::getActiveOffers(MARKETACTION_BUY, it.id);
@@ -5248,6 +5459,12 @@ void Game::playerAcceptMarketOffer(uint32_t playerId, uint32_t timestamp, uint16
 		return;
 	}
 
+	// the copy its owner's login is reading would overwrite the trade, it can be accepted again in a moment
+	if (IOLoginData::isLoadingPlayer(offer.playerId)) {
+		player->sendTextMessage(MESSAGE_INFO_DESCR, "The offer can not be accepted right now, try again in a moment.");
+		return;
+	}
+
 	const ItemType& it = Item::items[offer.itemId];
 	if (it.id == 0) {
 		return;
@@ -5520,37 +5737,85 @@ void Game::addPlayer(Player* player)
 {
 	const std::string& lowercase_name = asLowerCaseString(player->getName());
 	mappedPlayerNames[lowercase_name] = player;
+	mappedPlayerGuids[player->getGUID()] = player;
 	wildcardTree.insert(lowercase_name);
-	players[player->getID()] = player;
+	players.insert(player);
+
+	for (uint32_t vipGuid : player->VIPList) {
+		vipWatchers[vipGuid].insert(player);
+	}
 }
 
 void Game::removePlayer(Player* player)
 {
 	const std::string& lowercase_name = asLowerCaseString(player->getName());
 	mappedPlayerNames.erase(lowercase_name);
+	mappedPlayerGuids.erase(player->getGUID());
 	wildcardTree.remove(lowercase_name);
-	players.erase(player->getID());
+	players.erase(player);
+
+	for (uint32_t vipGuid : player->VIPList) {
+		removeVIPWatcher(vipGuid, player);
+	}
+}
+
+void Game::addVIPWatcher(uint32_t guid, Player* watcher)
+{
+	vipWatchers[guid].insert(watcher);
+}
+
+void Game::removeVIPWatcher(uint32_t guid, Player* watcher)
+{
+	auto it = vipWatchers.find(guid);
+	if (it == vipWatchers.end()) {
+		return;
+	}
+
+	it->second.erase(watcher);
+	if (it->second.empty()) {
+		vipWatchers.erase(it);
+	}
+}
+
+void Game::notifyVIPWatchers(Player* player, VipStatus_t status, bool ignoreAccessPlayers/* = false*/)
+{
+	auto it = vipWatchers.find(player->getGUID());
+	if (it == vipWatchers.end()) {
+		return;
+	}
+
+	for (Player* watcher : it->second) {
+		if (!ignoreAccessPlayers || !watcher->isAccessPlayer()) {
+			watcher->notifyStatusChange(player, status);
+		}
+	}
 }
 
 void Game::addNpc(Npc* npc)
 {
-	npcs[npc->getID()] = npc;
+	if (npcs.insert(npc)) {
+		mappedNpcNames.emplace(asLowerCaseString(npc->getName()), npc);
+	}
 }
 
 void Game::removeNpc(Npc* npc)
 {
-	npcs.erase(npc->getID());
+	if (npcs.erase(npc)) {
+		eraseMappedName(mappedNpcNames, npc);
+	}
 }
 
 void Game::addPokemon(Pokemon* pokemon)
 {
-	pokemons[pokemon->getID()] = pokemon;
+	if (pokemons.insert(pokemon)) {
+		mappedPokemonNames.emplace(asLowerCaseString(pokemon->getName()), pokemon);
+	}
 }
 
 void Game::removePokemon(Pokemon* pokemon)
 {
-	if (!pokemon->isPersistent()) {
-		pokemons.erase(pokemon->getID());
+	if (!pokemon->isPersistent() && pokemons.erase(pokemon)) {
+		eraseMappedName(mappedPokemonNames, pokemon);
 	}
 }
 
@@ -5790,27 +6055,39 @@ void Game::transformPokeball(Cylinder* fromCylinder, Cylinder* toCylinder, Item*
 	}
 
 	if (pokeball->getPokemonId() && (fromCylinder != toCylinder) && !pokeball->isStackable()) {
-		Pokemon* pokemon = getPokemonByGUID(pokeball->getPokemonId());
-		if (!pokemon) {
+		if (Pokemon* pokemon = getLoadedPokemonByGUID(pokeball->getPokemonId())) {
+			updatePokeballIcon(pokeball, pokemon);
 			return;
 		}
 
-		const PokeballType* pokeballType = pokemon->getPokeballType();
-		if (pokeballType) {
-			Cylinder* parent = pokeball->getParent();
+		// the icon follows once the pokemon is loaded, wherever the ball is by then
+		pokeball->incrementReferenceCounter();
+		loadPokemon(pokeball->getPokemonId(), [this, pokeball](Pokemon* pokemon) {
+			if (pokemon && !pokeball->isRemoved()) {
+				updatePokeballIcon(pokeball, pokemon);
+			}
+			ReleaseItem(pokeball);
+		});
+	}
+}
+
+void Game::updatePokeballIcon(Item* pokeball, Pokemon* pokemon)
+{
+	const PokeballType* pokeballType = pokemon->getPokeballType();
+	if (pokeballType) {
+		Cylinder* parent = pokeball->getParent();
 
-			if (parent->getContainer() || parent->getCreature()) {
-				if (pokeball->getID() == pokeballType->getChargedID()){
-					transformItem(pokeball, pokemon->getChargedIcon());
-				} else if (pokeball->getID() == pokeballType->getDischargedID()){
-					transformItem(pokeball, pokemon->getDischargedIcon());
-				}
-			} else if (parent->getTile()) {
-				if (pokeball->getID() == pokemon->getChargedIcon()){
-					transformItem(pokeball, pokeballType->getChargedID());
-				} else if (pokeball->getID() == pokemon->getDischargedIcon()){
-					transformItem(pokeball, pokeballType->getDischargedID());
-				}
+		if (parent->getContainer() || parent->getCreature()) {
+			if (pokeball->getID() == pokeballType->getChargedID()){
+				transformItem(pokeball, pokemon->getChargedIcon());
+			} else if (pokeball->getID() == pokeballType->getDischargedID()){
+				transformItem(pokeball, pokemon->getDischargedIcon());
+			}
+		} else if (parent->getTile()) {
+			if (pokeball->getID() == pokemon->getChargedIcon()){
+				transformItem(pokeball, pokeballType->getChargedID());
+			} else if (pokeball->getID() == pokemon->getDischargedIcon()){
+				transformItem(pokeball, pokeballType->getDischargedID());
 			}
 		}
 	}
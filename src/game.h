@@ -32,6 +32,7 @@
 #include "raids.h"
 #include "npc.h"
 #include "wildcardtree.h"
+#include "creatureindex.h"
 #include "quests.h"
 
 class ServiceManager;
@@ -74,6 +75,8 @@ enum LightState_t {
 static constexpr int32_t EVENT_LIGHTINTERVAL = 60000;
 static constexpr int32_t EVENT_DECAYINTERVAL = 250;
 static constexpr int32_t EVENT_DECAY_BUCKETS = 4;
+static constexpr int32_t EVENT_ROLLINGSAVEINTERVAL = 1000;
+static constexpr int32_t EVENT_JOURNALINTERVAL_MIN = 100;
 
 /**
   * Main Game class.
@@ -127,6 +130,16 @@ class Game
 		  */
 		Creature* getCreatureByID(uint32_t id);
 
+		// creature ids come from the index of their type and return to it on deletion
+		uint32_t reserveCreatureID(CreatureType_t type);
+		void releaseCreatureID(uint32_t id);
+		bool isPlayerID(uint32_t id) const {
+			return players.contains(id);
+		}
+		bool isPokemonID(uint32_t id) const {
+			return pokemons.contains(id);
+		}
+
 		/**
 		  * Returns a pokemon based on the unique creature identifier
 		  * \param id is the unique pokemon id to get a pokemon pointer to
@@ -135,11 +148,29 @@ class Game
 		Pokemon* getPokemonByID(uint32_t id);
 
 		/**
-		  * Returns a pokémon based on guid
-		  * \returns A Pointer to the pokémon
+		  * Returns a pokémon based on guid, one that is not in memory yet
+		  * gets loaded in the background
+		  * \returns A Pointer to the pokémon or nullptr until it is loaded
 		  */
 		Pokemon* getPokemonByGUID(const uint32_t& guid);
 
+		/**
+		  * Returns a pokémon based on guid, without loading it
+		  * \returns A Pointer to the pokémon or nullptr if it is not in memory
+		  */
+		Pokemon* getLoadedPokemonByGUID(uint32_t guid);
+		bool isLoadingPokemon(uint32_t guid) const {
+			return loadingPokemons.find(guid) != loadingPokemons.end();
+		}
+
+		// stored pokemon, loaded off the dispatcher or just written for the first time
+		void addLoadedPokemons(const std::vector<Pokemon*>& loaded);
+		void loadPokemons(const std::vector<uint32_t>& guids);
+		// callback gets the pokemon once it is loaded, right away if it already is, or nullptr if it could not be
+		void loadPokemon(uint32_t guid, std::function<void(Pokemon*)> callback);
+		// pokemon of a player that logged out, unless they are back or their pokemon is out
+		void unloadPokemons(uint32_t ownerGuid, const std::vector<uint32_t>& guids);
+
 		/**
 		  * Returns a npc based on the unique creature identifier
 		  * \param id is the unique npc id to get a npc pointer to
@@ -498,12 +529,17 @@ class Game
 		uint32_t getMotdNum() const { return motdNum; }
 		void incrementMotdNum() { motdNum++; }
 
-		const std::unordered_map<uint32_t, Player*>& getPlayers() const { return players; }
-		const std::map<uint32_t, Npc*>& getNpcs() const { return npcs; }
+		const CreatureIndex<Player>& getPlayers() const { return players; }
+		const CreatureIndex<Npc>& getNpcs() const { return npcs; }
 
 		void addPlayer(Player* player);
 		void removePlayer(Player* player);
 
+		// online players that have the guid in their VIP list
+		void addVIPWatcher(uint32_t guid, Player* watcher);
+		void removeVIPWatcher(uint32_t guid, Player* watcher);
+		void notifyVIPWatchers(Player* player, VipStatus_t status, bool ignoreAccessPlayers = false);
+
 		void addNpc(Npc* npc);
 		void removeNpc(Npc* npc);
 
@@ -532,6 +568,7 @@ class Game
 		Position getClosestFreeTile(Creature* creature, Position pos, bool extended/* = false*/);
 
 		void transformPokeball(Cylinder* fromCylinder, Cylinder* toCylinder, Item* item);
+		void updatePokeballIcon(Item* pokeball, Pokemon* pokemon);
 
 		// time functions
 		bool isDay();
@@ -555,8 +592,13 @@ class Game
 		void checkDecay();
 		void internalDecayItem(Item* item);
 
-		std::unordered_map<uint32_t, Player*> players;
+		void checkRollingSave();
+		void checkJournal();
+
+		CreatureIndex<Player> players { 0x10000000, 0x3FFFFFFF };
 		std::unordered_map<std::string, Player*> mappedPlayerNames;
+		std::unordered_map<uint32_t, Player*> mappedPlayerGuids;
+		std::unordered_map<uint32_t, std::unordered_set<Player*>> vipWatchers;
 		std::unordered_map<uint32_t, Guild*> guilds;
 		std::unordered_map<uint16_t, Item*> uniqueItems;
 		std::map<uint32_t, uint32_t> stages;
@@ -573,8 +615,14 @@ class Game
 
 		WildcardTreeNode wildcardTree { false };
 
-		std::map<uint32_t, Npc*> npcs;
-		std::map<uint32_t, Pokemon*> pokemons;
+		CreatureIndex<Npc> npcs { 0x80000000, 0xFFFFFFFF };
+		CreatureIndex<Pokemon> pokemons { 0x40000000, 0x7FFFFFFF };
+		// lowercase names, several npcs or pokemon may share one
+		std::unordered_multimap<std::string, Npc*> mappedNpcNames;
+		std::unordered_multimap<std::string, Pokemon*> mappedPokemonNames;
+		std::unordered_map<uint32_t, Pokemon*> loadedPokemons; // stored ones by guid
+		std::unordered_set<uint32_t> loadingPokemons;
+		std::map<uint32_t, std::vector<std::function<void(Pokemon*)>>> loadingPokemonCallbacks;
 		
 		//list of items that are in trading state, mapped to the player
 		std::map<Item*, uint32_t> tradeItems;
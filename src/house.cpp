@@ -27,6 +27,7 @@
 #include "game.h"
 #include "configmanager.h"
 #include "bed.h"
+#include "databasetasks.h"
 
 extern ConfigManager g_config;
 extern Game g_game;
@@ -41,12 +42,22 @@ void House::addTile(HouseTile* tile)
 
 void House::setOwner(uint32_t guid, bool updateDatabase/* = true*/, Player* player/* = nullptr*/)
 {
-	if (updateDatabase && owner != guid) {
-		Database& db = Database::getInstance();
+	// the items of the old owner go to a depot their login is still reading
+	if (!player && owner != 0 && owner != guid) {
+		bool deferred = IOLoginData::deferWhileLoading(owner, [this, guid, updateDatabase]() {
+			setOwner(guid, updateDatabase, g_game.getPlayerByGUID(owner));
+		});
+		if (deferred) {
+			return;
+		}
+	}
 
+	if (updateDatabase && owner != guid) {
 		std::ostringstream query;
 		query << "UPDATE `houses` SET `owner` = " << guid << ", `bid` = 0, `bid_end` = 0, `last_bid` = 0, `highest_bidder` = 0  WHERE `id` = " << id;
-		db.executeQuery(query.str());
+
+		// queued behind any house save still being written, which holds the old owner
+		g_databaseTasks.addTask(query.str(), nullptr, false, DATABASE_ORDER_HOUSES);
 	}
 
 	if (isLoaded && owner == guid) {
@@ -226,6 +226,15 @@ class House
 			return static_cast<uint32_t>(std::ceil(bedsList.size() / 2.)); //each bed takes 2 sqms of space, ceil is just for bad maps
 		}
 
+		// set whenever an item on one of the house tiles changes, only
+		// changed houses get their items written on the next save
+		void setItemsChanged(bool changed) {
+			itemsChanged = changed;
+		}
+		bool hasItemsChanged() const {
+			return itemsChanged;
+		}
+
 	private:
 		bool transferToDepot() const;
 		bool transferToDepot(Player* player) const;
@@ -255,6 +264,7 @@ class House
 		Position posEntry = {};
 
 		bool isLoaded = false;
+		bool itemsChanged = false;
 };
 
 using HouseMap = std::map<uint32_t, House*>;
@@ -38,6 +38,7 @@ void HouseTile::addThing(int32_t index, Thing* thing)
 	}
 
 	if (Item* item = thing->getItem()) {
+		house->setItemsChanged(true);
 		updateHouse(item);
 	}
 }
@@ -51,10 +52,51 @@ void HouseTile::internalAddThing(uint32_t index, Thing* thing)
 	}
 
 	if (Item* item = thing->getItem()) {
+		house->setItemsChanged(true);
 		updateHouse(item);
 	}
 }
 
+void HouseTile::updateThing(Thing* thing, uint16_t itemId, uint32_t count)
+{
+	Tile::updateThing(thing, itemId, count);
+	house->setItemsChanged(true);
+}
+
+void HouseTile::replaceThing(uint32_t index, Thing* thing)
+{
+	Tile::replaceThing(index, thing);
+	house->setItemsChanged(true);
+}
+
+void HouseTile::removeThing(Thing* thing, uint32_t count)
+{
+	Tile::removeThing(thing, count);
+
+	if (thing->getItem()) {
+		house->setItemsChanged(true);
+	}
+}
+
+void HouseTile::postAddNotification(Thing* thing, const Cylinder* oldParent, int32_t index, cylinderlink_t link/* = LINK_OWNER*/)
+{
+	// also reached for items moved in and out of containers on this tile
+	if (thing->getItem()) {
+		house->setItemsChanged(true);
+	}
+
+	Tile::postAddNotification(thing, oldParent, index, link);
+}
+
+void HouseTile::postRemoveNotification(Thing* thing, const Cylinder* newParent, int32_t index, cylinderlink_t link/* = LINK_OWNER*/)
+{
+	if (thing->getItem()) {
+		house->setItemsChanged(true);
+	}
+
+	Tile::postRemoveNotification(thing, newParent, index, link);
+}
+
 void HouseTile::updateHouse(Item* item)
 {
 	if (item->getParent() != this) {
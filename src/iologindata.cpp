@@ -22,11 +22,19 @@
 
 #include "iologindata.h"
 #include "configmanager.h"
+#include "databasetasks.h"
 #include "game.h"
+#include "journal.h"
+#include "tasks.h"
 
 extern ConfigManager g_config;
+extern Dispatcher g_dispatcher;
 extern Game g_game;
 
+std::atomic<uint64_t> IOLoginData::saveSequence{0};
+std::map<uint32_t, std::vector<std::function<void(void)>>> IOLoginData::storedItemsCallbacks;
+std::map<uint32_t, IOLoginData::LoadingPlayer> IOLoginData::loadingPlayers;
+
 Account IOLoginData::loadAccount(uint32_t accno)
 {
 	Account account;
@@ -230,35 +238,232 @@ bool IOLoginData::preloadPlayer(Player* player, const std::string& name)
 	return true;
 }
 
-bool IOLoginData::loadPlayerById(Player* player, uint32_t id)
+namespace {
+
+#define PLAYER_SELECT "SELECT `id`, `name`, `account_id`, `group_id`, `sex`, `profession`, `clan`, `experience`, `level`, `health`, `healthmax`, `pokemon_capacity`, `blessings`, `lookbody`, `lookfeet`, `lookhead`, `looklegs`, `looktype`, `lookaddons`, `posx`, `posy`, `posz`, `cap`, `lastlogin`, `lastlogout`, `lastip`, `conditions`, `town_id`, `balance`, `stamina`, `onlinetime`, `skill_fist`, `skill_fist_tries`, `skill_club`, `skill_club_tries`, `skill_sword`, `skill_sword_tries`, `skill_axe`, `skill_axe_tries`, `skill_dist`, `skill_dist_tries`, `skill_shielding`, `skill_shielding_tries`, `skill_fishing`, `skill_fishing_tries` FROM `characters` WHERE "
+
+// column positions of PLAYER_SELECT
+enum PlayerColumn : size_t {
+	PLAYER_ID,
+	PLAYER_NAME,
+	PLAYER_ACCOUNT_ID,
+	PLAYER_GROUP_ID,
+	PLAYER_SEX,
+	PLAYER_PROFESSION,
+	PLAYER_CLAN,
+	PLAYER_EXPERIENCE,
+	PLAYER_LEVEL,
+	PLAYER_HEALTH,
+	PLAYER_HEALTHMAX,
+	PLAYER_POKEMON_CAPACITY,
+	PLAYER_BLESSINGS,
+	PLAYER_LOOKBODY,
+	PLAYER_LOOKFEET,
+	PLAYER_LOOKHEAD,
+	PLAYER_LOOKLEGS,
+	PLAYER_LOOKTYPE,
+	PLAYER_LOOKADDONS,
+	PLAYER_POSX,
+	PLAYER_POSY,
+	PLAYER_POSZ,
+	PLAYER_CAP,
+	PLAYER_LASTLOGIN,
+	PLAYER_LASTLOGOUT,
+	PLAYER_LASTIP,
+	PLAYER_CONDITIONS,
+	PLAYER_TOWN_ID,
+	PLAYER_BALANCE,
+	PLAYER_STAMINA,
+	PLAYER_ONLINETIME,
+	PLAYER_SKILL_FIRST, // level and tries of each skill follow in skills_t order
+};
+
+// column positions of the character item selects
+enum ItemColumn : size_t {
+	ITEM_PID,
+	ITEM_SID,
+	ITEM_TYPE,
+	ITEM_COUNT,
+	ITEM_ATTRIBUTES,
+};
+
+#define POKEMON_SELECT "SELECT `id`, `pokeball`, `type`, `shiny`, `nickname`, `gender`, `nature`, `hpnow`, `hp`, `atk`, `def`, `speed`, `spatk`, `spdef`, `conditions`, `moves`, `abilities` FROM `pokemon` WHERE `id` = ?"
+
+// column positions of POKEMON_SELECT
+enum PokemonColumn : size_t {
+	POKEMON_ID,
+	POKEMON_POKEBALL,
+	POKEMON_TYPE,
+	POKEMON_SHINY,
+	POKEMON_NICKNAME,
+	POKEMON_GENDER,
+	POKEMON_NATURE,
+	POKEMON_HPNOW,
+	POKEMON_HP,
+	POKEMON_ATK,
+	POKEMON_DEF,
+	POKEMON_SPEED,
+	POKEMON_SPATK,
+	POKEMON_SPDEF,
+	POKEMON_CONDITIONS,
+	POKEMON_MOVES,
+	POKEMON_ABILITIES,
+};
+
+/**
+ * Serializes the writes of one player or pokemon, and drops a snapshot when
+ * a newer one of the same key was written first, whatever thread each of
+ * them runs on. A key is only remembered while snapshots of it are pending.
+ */
+class SaveOrder
 {
-	Database& db = Database::getInstance();
-	std::ostringstream query;
-	query << "SELECT `id`, `name`, `account_id`, `group_id`, `sex`, `profession`, `clan`, `experience`, `level`, `health`, `healthmax`, `pokemon_capacity`, `blessings`, `lookbody`, `lookfeet`, `lookhead`, `looklegs`, `looktype`, `lookaddons`, `posx`, `posy`, `posz`, `cap`, `lastlogin`, `lastlogout`, `lastip`, `conditions`, `town_id`, `balance`, `stamina`, `skill_fist`, `skill_fist_tries`, `skill_club`, `skill_club_tries`, `skill_sword`, `skill_sword_tries`, `skill_axe`, `skill_axe_tries`, `skill_dist`, `skill_dist_tries`, `skill_shielding`, `skill_shielding_tries`, `skill_fishing`, `skill_fishing_tries` FROM `characters` WHERE `id` = " << id;
-	return loadPlayer(player, db.storeQuery(query.str()));
+	public:
+		// a snapshot of the key was taken and will reach write or writeBatch
+		void addPending(uint64_t key) {
+			if (key == 0) {
+				return;
+			}
+
+			std::lock_guard<std::mutex> entryGuard(entryLock);
+			++entries[key].pending;
+		}
+
+		template<typename Write>
+		bool write(uint64_t key, uint64_t sequence, Write write) {
+			// new rows have no identity to order by yet
+			if (key == 0) {
+				return write();
+			}
+
+			std::lock_guard<std::mutex> keyGuard(keyLocks[key % KEY_LOCKS]);
+			bool newest = getWritten(key) <= sequence;
+			bool success = !newest || write();
+
+			std::lock_guard<std::mutex> entryGuard(entryLock);
+			if (newest && success) {
+				entries[key].written = sequence;
+			}
+			release(key);
+			return success;
+		}
+
+		/**
+		 * Same for many keys at once; write gets the snapshots that are
+		 * still the newest of their key.
+		 */
+		template<typename Snapshot, typename Write>
+		bool writeBatch(const std::vector<Snapshot>& snapshots, Write write) {
+			// only the locks of these keys, taken in order, so batches and single writes can't deadlock
+			std::vector<size_t> lockIndexes;
+			lockIndexes.reserve(snapshots.size());
+			for (const Snapshot& snapshot : snapshots) {
+				lockIndexes.push_back(snapshot.guid % KEY_LOCKS);
+			}
+			std::sort(lockIndexes.begin(), lockIndexes.end());
+			lockIndexes.erase(std::unique(lockIndexes.begin(), lockIndexes.end()), lockIndexes.end());
+
+			std::vector<std::unique_lock<std::mutex>> keyGuards;
+			keyGuards.reserve(lockIndexes.size());
+			for (size_t index : lockIndexes) {
+				keyGuards.emplace_back(keyLocks[index]);
+			}
+
+			std::vector<const Snapshot*> current;
+			current.reserve(snapshots.size());
+			for (const Snapshot& snapshot : snapshots) {
+				if (getWritten(snapshot.guid) <= snapshot.sequence) {
+					current.push_back(&snapshot);
+				}
+			}
+
+			bool success = current.empty() || write(current);
+
+			std::lock_guard<std::mutex> entryGuard(entryLock);
+			if (success) {
+				for (const Snapshot* snapshot : current) {
+					entries[snapshot->guid].written = snapshot->sequence;
+				}
+			}
+			for (const Snapshot& snapshot : snapshots) {
+				release(snapshot.guid);
+			}
+			return success;
+		}
+
+	private:
+		struct Entry {
+			uint64_t written = 0;
+			uint32_t pending = 0;
+		};
+
+		uint64_t getWritten(uint64_t key) {
+			std::lock_guard<std::mutex> entryGuard(entryLock);
+			auto it = entries.find(key);
+			return it != entries.end() ? it->second.written : 0;
+		}
+
+		// entryLock held; once nothing older can come the key is forgotten
+		void release(uint64_t key) {
+			auto it = entries.find(key);
+			if (it == entries.end()) {
+				return;
+			}
+
+			if (it->second.pending > 0) {
+				--it->second.pending;
+			}
+			if (it->second.pending == 0) {
+				entries.erase(it);
+			}
+		}
+
+		static constexpr size_t KEY_LOCKS = 64;
+
+		std::mutex keyLocks[KEY_LOCKS];
+		std::mutex entryLock;
+		std::unordered_map<uint64_t, Entry> entries;
+};
+
+SaveOrder playerSaveOrder;
+SaveOrder pokemonSaveOrder;
+
 }
 
-bool IOLoginData::loadPlayerByName(Player* player, const std::string& name)
+bool IOLoginData::loadPlayerById(Player* player, uint32_t id, bool detached/* = false*/)
 {
-	Database& db = Database::getInstance();
-	std::ostringstream query;
-	query << "SELECT `id`, `name`, `account_id`, `group_id`, `sex`, `profession`, `clan`, `experience`, `level`, `health`, `healthmax`, `pokemon_capacity`, `blessings`, `lookbody`, `lookfeet`, `lookhead`, `looklegs`, `looktype`, `lookaddons`, `posx`, `posy`, `posz`, `cap`, `lastlogin`, `lastlogout`, `lastip`, `conditions`, `town_id`, `balance`, `stamina`, `skill_fist`, `skill_fist_tries`, `skill_club`, `skill_club_tries`, `skill_sword`, `skill_sword_tries`, `skill_axe`, `skill_axe_tries`, `skill_dist`, `skill_dist_tries`, `skill_shielding`, `skill_shielding_tries`, `skill_fishing`, `skill_fishing_tries` FROM `characters` WHERE `name` = " << db.escapeString(name);
-	return loadPlayer(player, db.storeQuery(query.str()));
+	DBStatement stmt = Database::getInstance().prepare(PLAYER_SELECT "`id` = ?");
+	stmt.bind(id);
+	if (!stmt.execute() || !stmt.hasNext()) {
+		return false;
+	}
+	return loadPlayer(player, stmt, detached);
 }
 
-bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
+bool IOLoginData::loadPlayerByName(Player* player, const std::string& name)
 {
-	if (!result) {
+	DBStatement stmt = Database::getInstance().prepare(PLAYER_SELECT "`name` = ?");
+	stmt.bind(name);
+	if (!stmt.execute() || !stmt.hasNext()) {
 		return false;
 	}
+	return loadPlayer(player, stmt);
+}
 
+bool IOLoginData::loadPlayer(Player* player, DBStatement& result, bool detached/* = false*/)
+{
+	// a detached load does not touch the game state, so it can run on a
+	// database worker; its guild must be bound later on the dispatcher
 	Database& db = Database::getInstance();
 
-	uint32_t accno = result->getNumber<uint32_t>("account_id");
+	uint32_t accno = result.getNumber<uint32_t>(PLAYER_ACCOUNT_ID);
 	Account acc = loadAccount(accno);
 
-	player->setGUID(result->getNumber<uint32_t>("id"));
-	player->name = result->getString("name");
+	// saves of an earlier session must not be mistaken for this one's
+	player->savedSequence = saveSequence;
+	player->lastSaveTime = OTSYS_TIME();
+
+	player->setGUID(result.getNumber<uint32_t>(PLAYER_ID));
+	player->name = result.getString(PLAYER_NAME);
 	player->accountNumber = accno;
 
 	player->accountType = acc.accountType;
@@ -269,19 +474,19 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		player->premiumDays = acc.premiumDays;
 	}
 
-	Group* group = g_game.groups.getGroup(result->getNumber<uint16_t>("group_id"));
+	Group* group = g_game.groups.getGroup(result.getNumber<uint16_t>(PLAYER_GROUP_ID));
 	if (!group) {
-		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Group ID " << result->getNumber<uint16_t>("group_id") << " which doesn't exist" << std::endl;
+		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Group ID " << result.getNumber<uint16_t>(PLAYER_GROUP_ID) << " which doesn't exist" << std::endl;
 		return false;
 	}
 	player->setGroup(group);
 
-	player->bankBalance = result->getNumber<uint64_t>("balance");
+	player->bankBalance = result.getNumber<uint64_t>(PLAYER_BALANCE);
 
-	player->setSex(static_cast<PlayerSex_t>(result->getNumber<uint16_t>("sex")));
-	player->level = std::max<uint32_t>(1, result->getNumber<uint32_t>("level"));
+	player->setSex(static_cast<PlayerSex_t>(result.getNumber<uint16_t>(PLAYER_SEX)));
+	player->level = std::max<uint32_t>(1, result.getNumber<uint32_t>(PLAYER_LEVEL));
 
-	uint64_t experience = result->getNumber<uint64_t>("experience");
+	uint64_t experience = result.getNumber<uint64_t>(PLAYER_EXPERIENCE);
 
 	uint64_t currExpCount = Player::getExpForLevel(player->level);
 	uint64_t nextExpCount = Player::getExpForLevel(player->level + 1);
@@ -290,6 +495,8 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 	}
 
 	player->experience = experience;
+	player->journaledLevel = player->level;
+	player->journaledExperience = experience;
 
 	if (currExpCount < nextExpCount) {
 		player->levelPercent = Player::getPercentLevel(player->experience - currExpCount, nextExpCount - currExpCount);
@@ -297,11 +504,11 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		player->levelPercent = 0;
 	}
 
-	player->capacity = result->getNumber<uint32_t>("cap") * 100;
-	player->blessings = result->getNumber<uint16_t>("blessings");
+	player->capacity = result.getNumber<uint32_t>(PLAYER_CAP) * 100;
+	player->blessings = result.getNumber<uint16_t>(PLAYER_BLESSINGS);
 
 	unsigned long conditionsSize;
-	const char* conditions = result->getStream("conditions", conditionsSize);
+	const char* conditions = result.getStream(PLAYER_CONDITIONS, conditionsSize);
 	PropStream propStream;
 	propStream.init(conditions, conditionsSize);
 
@@ -315,37 +522,38 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		condition = Condition::createCondition(propStream);
 	}
 
-	if (!player->setProfession(result->getNumber<uint16_t>("profession"))) {
-		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Profession ID " << result->getNumber<uint16_t>("profession") << " which doesn't exist" << std::endl;
+	if (!player->setProfession(result.getNumber<uint16_t>(PLAYER_PROFESSION))) {
+		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Profession ID " << result.getNumber<uint16_t>(PLAYER_PROFESSION) << " which doesn't exist" << std::endl;
 		return false;
 	}
 
-	if (!player->setClan(result->getNumber<uint16_t>("clan"))) {
-		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Clan ID " << result->getNumber<uint16_t>("clan") << " which doesn't exist" << std::endl;
+	if (!player->setClan(result.getNumber<uint16_t>(PLAYER_CLAN))) {
+		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Clan ID " << result.getNumber<uint16_t>(PLAYER_CLAN) << " which doesn't exist" << std::endl;
 		return false;
 	}
 
-	player->health = result->getNumber<int32_t>("health");
-	player->healthMax = result->getNumber<int32_t>("healthmax");
+	player->health = result.getNumber<int32_t>(PLAYER_HEALTH);
+	player->healthMax = result.getNumber<int32_t>(PLAYER_HEALTHMAX);
 
-	player->defaultOutfit.lookType = result->getNumber<uint16_t>("looktype");
-	player->defaultOutfit.lookHead = result->getNumber<uint16_t>("lookhead");
-	player->defaultOutfit.lookBody = result->getNumber<uint16_t>("lookbody");
-	player->defaultOutfit.lookLegs = result->getNumber<uint16_t>("looklegs");
-	player->defaultOutfit.lookFeet = result->getNumber<uint16_t>("lookfeet");
-	player->defaultOutfit.lookAddons = result->getNumber<uint16_t>("lookaddons");
+	player->defaultOutfit.lookType = result.getNumber<uint16_t>(PLAYER_LOOKTYPE);
+	player->defaultOutfit.lookHead = result.getNumber<uint16_t>(PLAYER_LOOKHEAD);
+	player->defaultOutfit.lookBody = result.getNumber<uint16_t>(PLAYER_LOOKBODY);
+	player->defaultOutfit.lookLegs = result.getNumber<uint16_t>(PLAYER_LOOKLEGS);
+	player->defaultOutfit.lookFeet = result.getNumber<uint16_t>(PLAYER_LOOKFEET);
+	player->defaultOutfit.lookAddons = result.getNumber<uint16_t>(PLAYER_LOOKADDONS);
 	player->currentOutfit = player->defaultOutfit;
 
-	player->loginPosition.x = result->getNumber<uint16_t>("posx");
-	player->loginPosition.y = result->getNumber<uint16_t>("posy");
-	player->loginPosition.z = result->getNumber<uint16_t>("posz");
+	player->loginPosition.x = result.getNumber<uint16_t>(PLAYER_POSX);
+	player->loginPosition.y = result.getNumber<uint16_t>(PLAYER_POSY);
+	player->loginPosition.z = result.getNumber<uint16_t>(PLAYER_POSZ);
 
-	player->lastLoginSaved = result->getNumber<time_t>("lastlogin");
-	player->lastLogout = result->getNumber<time_t>("lastlogout");
+	player->lastLoginSaved = result.getNumber<time_t>(PLAYER_LASTLOGIN);
+	player->savedOnlineTime = result.getNumber<int64_t>(PLAYER_ONLINETIME);
+	player->lastLogout = result.getNumber<time_t>(PLAYER_LASTLOGOUT);
 
-	Town* town = g_game.map.towns.getTown(result->getNumber<uint32_t>("town_id"));
+	Town* town = g_game.map.towns.getTown(result.getNumber<uint32_t>(PLAYER_TOWN_ID));
 	if (!town) {
-		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Town ID " << result->getNumber<uint32_t>("town_id") << " which doesn't exist" << std::endl;
+		std::cout << "[Error - IOLoginData::loadPlayer] " << player->name << " has Town ID " << result.getNumber<uint32_t>(PLAYER_TOWN_ID) << " which doesn't exist" << std::endl;
 		return false;
 	}
 
@@ -356,14 +564,11 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 		player->loginPosition = player->getPokemonCenterPosition();
 	}
 
-	player->staminaMinutes = result->getNumber<uint16_t>("stamina");
+	player->staminaMinutes = result.getNumber<uint16_t>(PLAYER_STAMINA);
 
-	static const std::string skillNames[] = {"skill_fist", "skill_club", "skill_sword", "skill_axe", "skill_dist", "skill_shielding", "skill_fishing"};
-	static const std::string skillNameTries[] = {"skill_fist_tries", "skill_club_tries", "skill_sword_tries", "skill_axe_tries", "skill_dist_tries", "skill_shielding_tries", "skill_fishing_tries"};
-	static constexpr size_t size = sizeof(skillNames) / sizeof(std::string);
-	for (uint8_t i = 0; i < size; ++i) {
-		uint16_t skillLevel = result->getNumber<uint16_t>(skillNames[i]);
-		uint64_t skillTries = result->getNumber<uint64_t>(skillNameTries[i]);
+	for (uint8_t i = SKILL_FIRST; i <= SKILL_LAST; ++i) {
+		uint16_t skillLevel = result.getNumber<uint16_t>(PLAYER_SKILL_FIRST + (i * 2));
+		uint64_t skillTries = result.getNumber<uint64_t>(PLAYER_SKILL_FIRST + (i * 2) + 1);
 		uint64_t nextSkillTries = player->profession->getReqSkillTries(i, skillLevel + 1);
 		if (skillTries > nextSkillTries) {
 			skillTries = 0;
@@ -376,15 +581,18 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 
 	std::ostringstream query;
 	query << "SELECT `guild_id`, `guild_rank_id`, `nick` FROM `guild_memberships` WHERE `character_id` = " << player->getGUID();
-	if ((result = db.storeQuery(query.str()))) {
-		uint32_t guildId = result->getNumber<uint32_t>("guild_id");
-		uint32_t playerRankId = result->getNumber<uint32_t>("guild_rank_id");
-		player->guildNick = result->getString("nick");
+	DBResult_ptr guildResult;
+	if ((guildResult = db.storeQuery(query.str()))) {
+		uint32_t guildId = guildResult->getNumber<uint32_t>("guild_id");
+		uint32_t playerRankId = guildResult->getNumber<uint32_t>("guild_rank_id");
+		player->guildNick = guildResult->getString("nick");
 
-		Guild* guild = g_game.getGuild(guildId);
+		Guild* guild = detached ? nullptr : g_game.getGuild(guildId);
 		if (!guild) {
 			guild = IOGuild::loadGuild(guildId);
-			g_game.addGuild(guild);
+			if (guild && !detached) {
+				g_game.addGuild(guild);
+			}
 		}
 
 		if (guild) {
@@ -394,8 +602,8 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 				query.str(std::string());
 				query << "SELECT `id`, `name`, `level` FROM `guild_ranks` WHERE `id` = " << playerRankId;
 
-				if ((result = db.storeQuery(query.str()))) {
-					guild->addRank(result->getNumber<uint32_t>("id"), result->getString("name"), result->getNumber<uint16_t>("level"));
+				if ((guildResult = db.storeQuery(query.str()))) {
+					guild->addRank(guildResult->getNumber<uint32_t>("id"), guildResult->getString("name"), guildResult->getNumber<uint16_t>("level"));
 				}
 
 				rank = guild->getRankById(playerRankId);
@@ -410,8 +618,12 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 
 			query.str(std::string());
 			query << "SELECT COUNT(*) AS `members` FROM `guild_memberships` WHERE `guild_id` = " << guildId;
-			if ((result = db.storeQuery(query.str()))) {
-				guild->setMemberCount(result->getNumber<uint32_t>("members"));
+			if ((guildResult = db.storeQuery(query.str()))) {
+				guild->setMemberCount(guildResult->getNumber<uint32_t>("members"));
+			}
+
+			if (detached && !player->guild) {
+				delete guild;
 			}
 		}
 	}
@@ -419,10 +631,10 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 	//load inventory items
 	ItemMap itemMap;
 
-	query.str(std::string());
-	query << "SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `character_items` WHERE `character_id` = " << player->getGUID() << " ORDER BY `sid` DESC";
-	if ((result = db.storeQuery(query.str()))) {
-		loadItems(itemMap, result);
+	DBStatement itemsStmt = db.prepare("SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `character_items` WHERE `character_id` = ? ORDER BY `sid` DESC");
+	itemsStmt.bind(player->getGUID());
+	if (itemsStmt.execute() && itemsStmt.hasNext()) {
+		loadItems(itemMap, itemsStmt);
 
 		for (ItemMap::const_reverse_iterator it = itemMap.rbegin(), end = itemMap.rend(); it != end; ++it) {
 			const std::pair<Item*, int32_t>& pair = it->second;
@@ -442,96 +654,325 @@ bool IOLoginData::loadPlayer(Player* player, DBResult_ptr result)
 				}
 			}
 		}
+
+		// the pokemon in the inventory are needed right away, read them along
+		if (detached) {
+			loadItemPokemons(itemMap, player->pendingPokemons);
+		}
 	}
 
-	//load depot items
-	itemMap.clear();
+	//load depot and inbox items, players logging in only get them once needed;
+	//a failed read leaves them unloaded and the next access reads them again
+	player->storedItemsLoaded = false;
+	if (!detached) {
+		loadStoredItems(player);
+	}
 
-	query.str(std::string());
-	query << "SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `character_depotitems` WHERE `character_id` = " << player->getGUID() << " ORDER BY `sid` DESC";
-	if ((result = db.storeQuery(query.str()))) {
-		loadItems(itemMap, result);
+	//load storage map
+	DBStatement storageStmt = db.prepare("SELECT `key`, `value` FROM `character_storages` WHERE `character_id` = ?");
+	storageStmt.bind(player->getGUID());
+	if (storageStmt.execute() && storageStmt.hasNext()) {
+		do {
+			player->addStorageValue(storageStmt.getNumber<uint32_t>(0), storageStmt.getNumber<int32_t>(1), true);
+		} while (storageStmt.next());
+	}
+	player->storageMap.clearChanges();
 
-		for (ItemMap::const_reverse_iterator it = itemMap.rbegin(), end = itemMap.rend(); it != end; ++it) {
-			const std::pair<Item*, int32_t>& pair = it->second;
-			Item* item = pair.first;
+	//load vip
+	DBStatement vipStmt = db.prepare("SELECT `character_id` FROM `account_viplists` WHERE `account_id` = ?");
+	vipStmt.bind(player->getAccount());
+	if (vipStmt.execute() && vipStmt.hasNext()) {
+		do {
+			player->addVIPInternal(vipStmt.getNumber<uint32_t>(0));
+		} while (vipStmt.next());
+	}
 
-			int32_t pid = pair.second;
-			if (pid >= 0 && pid < 100) {
-				DepotChest* depotChest = player->getDepotChest(pid, true);
-				if (depotChest) {
-					depotChest->internalAddThing(item);
-				}
-			} else {
-				ItemMap::const_iterator it2 = itemMap.find(pid);
-				if (it2 == itemMap.end()) {
-					continue;
-				}
+	player->updateBaseSpeed();
+	player->updateInventoryWeight();
+	player->updateInventoryPokemonCount();
+	player->updateItemsLight(true);
+	return true;
+}
 
-				Container* container = it2->second.first->getContainer();
-				if (container) {
-					container->internalAddThing(item);
-				}
-			}
+void IOLoginData::bindPlayerGuild(Player* player)
+{
+	//dispatcher thread
+	Guild* loadedGuild = player->guild;
+	if (!loadedGuild) {
+		return;
+	}
+
+	Guild* guild = g_game.getGuild(loadedGuild->getId());
+	if (!guild) {
+		g_game.addGuild(loadedGuild);
+		return;
+	} else if (guild == loadedGuild) {
+		return;
+	}
+
+	// the guild is already loaded, keep that one and drop the detached copy
+	const GuildRank* loadedRank = player->guildRank;
+	const GuildRank* rank = guild->getRankById(loadedRank->id);
+	if (!rank) {
+		guild->addRank(loadedRank->id, loadedRank->name, loadedRank->level);
+		rank = guild->getRankById(loadedRank->id);
+	}
+
+	guild->setMemberCount(loadedGuild->getMemberCount());
+	player->guild = guild;
+	player->guildRank = rank;
+	delete loadedGuild;
+}
+
+bool IOLoginData::loadStoredItems(Player* player)
+{
+	//dispatcher thread
+	if (player->storedItemsLoaded) {
+		return true;
+	}
+
+	ItemMap depotItems, inboxItems;
+	if (!readStoredItems(player->getGUID(), depotItems, inboxItems)) {
+		std::cout << "Error while loading the depot and inbox items of player: " << player->getName() << std::endl;
+		return false;
+	}
+
+	attachStoredItems(player, depotItems, inboxItems);
+	return true;
+}
+
+void IOLoginData::loadStoredItemsAsync(Player* player, std::function<void(void)> callback/* = nullptr*/)
+{
+	//dispatcher thread
+	if (player->storedItemsLoaded) {
+		if (callback) {
+			callback();
 		}
+		return;
 	}
 
-	//load inbox items
-	itemMap.clear();
+	player->lastStoredItemsAccess = OTSYS_TIME();
 
-	query.str(std::string());
-	query << "SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `character_inboxitems` WHERE `character_id` = " << player->getGUID() << " ORDER BY `sid` DESC";
-	if ((result = db.storeQuery(query.str()))) {
-		loadItems(itemMap, result);
+	uint32_t guid = player->getGUID();
+	auto it = storedItemsCallbacks.find(guid);
+	if (it != storedItemsCallbacks.end()) {
+		// already on its way
+		if (callback) {
+			it->second.push_back(std::move(callback));
+		}
+		return;
+	}
 
-		for (ItemMap::const_reverse_iterator it = itemMap.rbegin(), end = itemMap.rend(); it != end; ++it) {
-			const std::pair<Item*, int32_t>& pair = it->second;
-			Item* item = pair.first;
-			int32_t pid = pair.second;
+	std::vector<std::function<void(void)>>& callbacks = storedItemsCallbacks[guid];
+	if (callback) {
+		callbacks.push_back(std::move(callback));
+	}
+
+	// same key as the saves of the player, so a save still being written is read back
+	g_databaseTasks.addWork([guid]() {
+		//database task thread
+		auto depotItems = std::make_shared<ItemMap>();
+		auto inboxItems = std::make_shared<ItemMap>();
+		auto pokemons = std::make_shared<std::vector<Pokemon*>>();
+		bool read = readStoredItems(guid, *depotItems, *inboxItems, pokemons.get());
 
-			if (pid >= 0 && pid < 100) {
-				player->getInbox()->internalAddThing(item);
+		g_dispatcher.addTask(createTask([guid, read, depotItems, inboxItems, pokemons]() {
+			Player* player = g_game.getPlayerByGUID(guid);
+			if (player && !read) {
+				// stays unloaded, the next access tries again
+				std::cout << "Error while loading the depot and inbox items of player: " << player->getName() << std::endl;
+			} else if (player && !player->storedItemsLoaded) {
+				attachStoredItems(player, *depotItems, *inboxItems);
+				g_game.addLoadedPokemons(*pokemons);
 			} else {
-				ItemMap::const_iterator it2 = itemMap.find(pid);
+				for (const auto& itemMap : {depotItems, inboxItems}) {
+					for (const auto& it : *itemMap) {
+						delete it.second.first;
+					}
+				}
 
-				if (it2 == itemMap.end()) {
-					continue;
+				for (Pokemon* pokemon : *pokemons) {
+					delete pokemon;
 				}
+			}
 
-				Container* container = it2->second.first->getContainer();
-				if (container) {
-					container->internalAddThing(item);
+			auto it = storedItemsCallbacks.find(guid);
+			if (it == storedItemsCallbacks.end()) {
+				return;
+			}
+
+			std::vector<std::function<void(void)>> callbacks = std::move(it->second);
+			storedItemsCallbacks.erase(it);
+			for (const auto& callback : callbacks) {
+				callback();
+			}
+		}));
+	}, guid);
+}
+
+bool IOLoginData::unloadStoredItems(Player* player)
+{
+	//dispatcher thread
+	if (!player->storedItemsLoaded || player->isInMarket()) {
+		return false;
+	}
+
+	for (const auto& it : player->openContainers) {
+		const Container* container = it.second.container;
+		const Cylinder* topParent = container->getTopParent();
+		if (container == player->inbox || dynamic_cast<const DepotLocker*>(topParent) || dynamic_cast<const DepotChest*>(topParent)) {
+			return false;
+		}
+	}
+
+	// only once the database holds all of it
+	PropWriteStream propWriteStream;
+	std::vector<std::string> sectionRows[SAVESECTION_LAST + 1];
+	serializeItemSections(player, propWriteStream, sectionRows);
+	for (uint8_t section = SAVESECTION_DEPOT; section <= SAVESECTION_INBOX; ++section) {
+		if (section == SAVESECTION_DEPOT && player->lastDepotId == -1) {
+			continue;
+		}
+
+		uint64_t digest = digestRows(sectionRows[section]);
+		if (digest != player->savedDigests[section] || digest != player->snapshotDigests[section]) {
+			return false;
+		}
+	}
+
+	// the pokemon of these items stay loaded, they just can't be reached through the player anymore
+	std::vector<const Container*> containers {player->inbox};
+	for (const auto& it : player->depotChests) {
+		containers.push_back(it.second);
+	}
+
+	std::vector<Pokemon*> pokemons;
+	for (const Container* container : containers) {
+		for (ContainerIterator it = container->iterator(); it.hasNext(); it.advance()) {
+			if ((*it)->getPokemonId() != 0) {
+				if (Pokemon* pokemon = g_game.getLoadedPokemonByGUID((*it)->getPokemonId())) {
+					pokemons.push_back(pokemon);
 				}
 			}
 		}
 	}
 
-	//load storage map
-	query.str(std::string());
-	query << "SELECT `key`, `value` FROM `character_storages` WHERE `character_id` = " << player->getGUID();
-	if ((result = db.storeQuery(query.str()))) {
-		do {
-			player->addStorageValue(result->getNumber<uint32_t>("key"), result->getNumber<int32_t>("value"), true);
-		} while (result->next());
+	if (!pokemons.empty()) {
+		savePokemonsAsync(pokemons);
 	}
 
-	//load vip
-	query.str(std::string());
-	query << "SELECT `character_id` FROM `account_viplists` WHERE `account_id` = " << player->getAccount();
-	if ((result = db.storeQuery(query.str()))) {
-		do {
-			player->addVIPInternal(result->getNumber<uint32_t>("character_id"));
-		} while (result->next());
+	for (const auto& it : player->depotChests) {
+		if (!it.second->getParent()) {
+			it.second->decrementReferenceCounter();
+		}
 	}
+	player->depotChests.clear();
 
-	player->updateBaseSpeed();
-	player->updateInventoryWeight();
-	player->updateInventoryPokemonCount();
-	player->updateItemsLight(true);
+	for (const auto& it : player->depotLockerMap) {
+		it.second->removeInbox(player->inbox);
+		it.second->decrementReferenceCounter();
+	}
+	player->depotLockerMap.clear();
+
+	player->inbox->decrementReferenceCounter();
+	player->inbox = new Inbox(ITEM_INBOX);
+	player->inbox->incrementReferenceCounter();
+
+	player->storedItemsLoaded = false;
 	return true;
 }
 
-bool IOLoginData::saveItems(const Player* player, const ItemBlockList& itemList, DBInsert& query_insert, PropWriteStream& propWriteStream)
+bool IOLoginData::readStoredItems(uint32_t guid, ItemMap& depotItems, ItemMap& inboxItems, std::vector<Pokemon*>* pokemons/* = nullptr*/)
+{
+	Database& db = Database::getInstance();
+
+	DBStatement depotStmt = db.prepare("SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `character_depotitems` WHERE `character_id` = ? ORDER BY `sid` DESC");
+	depotStmt.bind(guid);
+	if (!depotStmt.execute()) {
+		return false;
+	}
+
+	if (depotStmt.hasNext()) {
+		loadItems(depotItems, depotStmt);
+	}
+
+	// a part is of no use, the save would delete the rest
+	auto freeItems = [&depotItems]() {
+		for (const auto& it : depotItems) {
+			delete it.second.first;
+		}
+		depotItems.clear();
+	};
+
+	DBStatement inboxStmt = db.prepare("SELECT `pid`, `sid`, `itemtype`, `count`, `attributes` FROM `character_inboxitems` WHERE `character_id` = ? ORDER BY `sid` DESC");
+	inboxStmt.bind(guid);
+	if (!inboxStmt.execute()) {
+		freeItems();
+		return false;
+	}
+
+	if (inboxStmt.hasNext()) {
+		loadItems(inboxItems, inboxStmt);
+	}
+
+	if (pokemons) {
+		loadItemPokemons(depotItems, *pokemons);
+		loadItemPokemons(inboxItems, *pokemons);
+	}
+	return true;
+}
+
+void IOLoginData::attachStoredItems(Player* player, const ItemMap& depotItems, const ItemMap& inboxItems)
+{
+	for (ItemMap::const_reverse_iterator it = depotItems.rbegin(), end = depotItems.rend(); it != end; ++it) {
+		const std::pair<Item*, int32_t>& pair = it->second;
+		Item* item = pair.first;
+
+		int32_t pid = pair.second;
+		if (pid >= 0 && pid < 100) {
+			DepotChest* depotChest = player->getDepotChest(pid, true);
+			if (depotChest) {
+				depotChest->internalAddThing(item);
+			}
+		} else {
+			ItemMap::const_iterator it2 = depotItems.find(pid);
+			if (it2 == depotItems.end()) {
+				continue;
+			}
+
+			Container* container = it2->second.first->getContainer();
+			if (container) {
+				container->internalAddThing(item);
+			}
+		}
+	}
+
+	for (ItemMap::const_reverse_iterator it = inboxItems.rbegin(), end = inboxItems.rend(); it != end; ++it) {
+		const std::pair<Item*, int32_t>& pair = it->second;
+		Item* item = pair.first;
+		int32_t pid = pair.second;
+
+		if (pid >= 0 && pid < 100) {
+			player->inbox->internalAddThing(item);
+		} else {
+			ItemMap::const_iterator it2 = inboxItems.find(pid);
+
+			if (it2 == inboxItems.end()) {
+				continue;
+			}
+
+			Container* container = it2->second.first->getContainer();
+			if (container) {
+				container->internalAddThing(item);
+			}
+		}
+	}
+
+	player->storedItemsLoaded = true;
+	player->lastStoredItemsAccess = OTSYS_TIME();
+}
+
+void IOLoginData::serializeItems(const Player* player, const ItemBlockList& itemList, PropWriteStream& propWriteStream, std::vector<std::string>& rows)
 {
 	std::ostringstream ss;
 
@@ -553,9 +994,8 @@ bool IOLoginData::saveItems(const Player* player, const ItemBlockList& itemList,
 		const char* attributes = propWriteStream.getStream(attributesSize);
 
 		ss << player->getGUID() << ',' << pid << ',' << runningId << ',' << item->getID() << ',' << item->getSubType() << ',' << db.escapeBlob(attributes, attributesSize);
-		if (!query_insert.addRow(ss)) {
-			return false;
-		}
+		rows.emplace_back(ss.str());
+		ss.str(std::string());
 
 		if (Container* container = item->getContainer()) {
 			queue.emplace_back(container, runningId);
@@ -583,35 +1023,71 @@ bool IOLoginData::saveItems(const Player* player, const ItemBlockList& itemList,
 			const char* attributes = propWriteStream.getStream(attributesSize);
 
 			ss << player->getGUID() << ',' << parentId << ',' << runningId << ',' << item->getID() << ',' << item->getSubType() << ',' << db.escapeBlob(attributes, attributesSize);
-			if (!query_insert.addRow(ss)) {
-				return false;
-			}
+			rows.emplace_back(ss.str());
+			ss.str(std::string());
 		}
 	}
-	return query_insert.execute();
 }
 
 bool IOLoginData::savePlayer(Player* player)
 {
-	if (player->getHealth() <= 0) {
-		player->changeHealth(1);
+	PlayerSaveSnapshot snapshot;
+	if (!snapshotPlayer(player, snapshot)) {
+		return true;
 	}
 
-	Database& db = Database::getInstance();
+	if (!writePlayerSnapshot(snapshot)) {
+		return false;
+	}
 
-	std::ostringstream query;
-	query << "SELECT `save` FROM `characters` WHERE `id` = " << player->getGUID();
-	DBResult_ptr result = db.storeQuery(query.str());
-	if (!result) {
+	adoptPlayerSnapshot(player, snapshot);
+	return true;
+}
+
+bool IOLoginData::savePlayerAsync(Player* player, std::function<void(bool)> callback/* = nullptr*/)
+{
+	auto snapshot = std::make_shared<PlayerSaveSnapshot>();
+	if (!snapshotPlayer(player, *snapshot)) {
 		return false;
 	}
 
-	if (result->getNumber<uint16_t>("save") == 0) {
-		query.str(std::string());
-		query << "UPDATE `characters` SET `lastlogin` = " << player->lastLoginSaved << ", `lastip` = " << player->lastIP << " WHERE `id` = " << player->getGUID();
-		return db.executeQuery(query.str());
+	g_databaseTasks.addWork([snapshot, callback]() {
+		//database task thread
+		bool saved = writePlayerSnapshot(*snapshot);
+		if (saved) {
+			g_dispatcher.addTask(createTask([snapshot]() {
+				if (Player* player = g_game.getPlayerByGUID(snapshot->guid)) {
+					adoptPlayerSnapshot(player, *snapshot);
+				}
+			}));
+		}
+
+		if (callback) {
+			callback(saved);
+		}
+	}, snapshot->guid);
+	return true;
+}
+
+bool IOLoginData::snapshotPlayer(Player* player, PlayerSaveSnapshot& snapshot)
+{
+	if (player->getHealth() <= 0) {
+		player->changeHealth(1);
+	}
+
+	player->lastSaveTime = OTSYS_TIME();
+
+	// items sent to an inbox that was never read can't wait for it, the section is written as a whole
+	// if they can't be read the inbox section waits for the next save
+	if (!player->storedItemsLoaded && !player->inbox->empty()) {
+		loadStoredItems(player);
 	}
 
+	snapshot.guid = player->getGUID();
+	snapshot.sequence = ++saveSequence;
+	snapshot.lastLoginSaved = player->lastLoginSaved;
+	snapshot.lastIP = player->lastIP;
+
 	//serialize conditions
 	PropWriteStream propWriteStream;
 	for (Condition* condition : player->conditions) {
@@ -623,88 +1099,126 @@ bool IOLoginData::savePlayer(Player* player)
 
 	size_t conditionsSize;
 	const char* conditions = propWriteStream.getStream(conditionsSize);
-
-	//First, an UPDATE query to write the player itself
-	query.str(std::string());
-	query << "UPDATE `characters` SET ";
-	query << "`level` = " << player->level << ',';
-	query << "`group_id` = " << player->group->id << ',';
-	query << "`profession` = " << player->getProfessionId() << ',';
-	query << "`clan` = " << player->getClanId() << ',';
-	query << "`health` = " << player->health << ',';
-	query << "`healthmax` = " << player->healthMax << ',';
-	query << "`experience` = " << player->experience << ',';
-	query << "`lookbody` = " << static_cast<uint32_t>(player->defaultOutfit.lookBody) << ',';
-	query << "`lookfeet` = " << static_cast<uint32_t>(player->defaultOutfit.lookFeet) << ',';
-	query << "`lookhead` = " << static_cast<uint32_t>(player->defaultOutfit.lookHead) << ',';
-	query << "`looklegs` = " << static_cast<uint32_t>(player->defaultOutfit.lookLegs) << ',';
-	query << "`looktype` = " << player->defaultOutfit.lookType << ',';
-	query << "`lookaddons` = " << static_cast<uint32_t>(player->defaultOutfit.lookAddons) << ',';
-	query << "`pokemon_capacity` = " << 0 << ',';
-	query << "`town_id` = " << player->town->getID() << ',';
+	snapshot.conditions.assign(conditions, conditionsSize);
+
+	std::vector<std::pair<const char*, int64_t>>& stats = snapshot.stats;
+	stats.emplace_back("level", player->level);
+	stats.emplace_back("group_id", player->group->id);
+	stats.emplace_back("profession", player->getProfessionId());
+	stats.emplace_back("clan", player->getClanId());
+	stats.emplace_back("health", player->health);
+	stats.emplace_back("healthmax", player->healthMax);
+	stats.emplace_back("experience", player->experience);
+	stats.emplace_back("lookbody", player->defaultOutfit.lookBody);
+	stats.emplace_back("lookfeet", player->defaultOutfit.lookFeet);
+	stats.emplace_back("lookhead", player->defaultOutfit.lookHead);
+	stats.emplace_back("looklegs", player->defaultOutfit.lookLegs);
+	stats.emplace_back("looktype", player->defaultOutfit.lookType);
+	stats.emplace_back("lookaddons", player->defaultOutfit.lookAddons);
+	stats.emplace_back("pokemon_capacity", 0);
+	stats.emplace_back("town_id", player->town->getID());
 
 	const Position& loginPosition = player->getLoginPosition();
-	query << "`posx` = " << loginPosition.getX() << ',';
-	query << "`posy` = " << loginPosition.getY() << ',';
-	query << "`posz` = " << loginPosition.getZ() << ',';
+	stats.emplace_back("posx", loginPosition.getX());
+	stats.emplace_back("posy", loginPosition.getY());
+	stats.emplace_back("posz", loginPosition.getZ());
 
-	query << "`cap` = " << (player->capacity / 100) << ',';
-	query << "`sex` = " << player->sex << ',';
+	stats.emplace_back("cap", player->capacity / 100);
+	stats.emplace_back("sex", player->sex);
 
 	if (player->lastLoginSaved != 0) {
-		query << "`lastlogin` = " << player->lastLoginSaved << ',';
+		stats.emplace_back("lastlogin", player->lastLoginSaved);
 	}
 
 	if (player->lastIP != 0) {
-		query << "`lastip` = " << player->lastIP << ',';
-	}
-
-	query << "`conditions` = " << db.escapeBlob(conditions, conditionsSize) << ',';
-
-	query << "`lastlogout` = " << player->getLastLogout() << ',';
-	query << "`balance` = " << player->bankBalance << ',';
-	query << "`stamina` = " << player->getStaminaMinutes() << ',';
-
-	query << "`skill_fist` = " << player->skills[SKILL_FIST].level << ',';
-	query << "`skill_fist_tries` = " << player->skills[SKILL_FIST].tries << ',';
-	query << "`skill_club` = " << player->skills[SKILL_CLUB].level << ',';
-	query << "`skill_club_tries` = " << player->skills[SKILL_CLUB].tries << ',';
-	query << "`skill_sword` = " << player->skills[SKILL_SWORD].level << ',';
-	query << "`skill_sword_tries` = " << player->skills[SKILL_SWORD].tries << ',';
-	query << "`skill_axe` = " << player->skills[SKILL_AXE].level << ',';
-	query << "`skill_axe_tries` = " << player->skills[SKILL_AXE].tries << ',';
-	query << "`skill_dist` = " << player->skills[SKILL_DISTANCE].level << ',';
-	query << "`skill_dist_tries` = " << player->skills[SKILL_DISTANCE].tries << ',';
-	query << "`skill_shielding` = " << player->skills[SKILL_SHIELD].level << ',';
-	query << "`skill_shielding_tries` = " << player->skills[SKILL_SHIELD].tries << ',';
-	query << "`skill_fishing` = " << player->skills[SKILL_FISHING].level << ',';
-	query << "`skill_fishing_tries` = " << player->skills[SKILL_FISHING].tries << ',';
+		stats.emplace_back("lastip", player->lastIP);
+	}
+
+	stats.emplace_back("lastlogout", player->getLastLogout());
+	stats.emplace_back("balance", player->bankBalance);
+	stats.emplace_back("stamina", player->getStaminaMinutes());
+
+	static const char* const skillColumns[SKILL_LAST + 1][2] = {
+		{"skill_fist", "skill_fist_tries"},
+		{"skill_club", "skill_club_tries"},
+		{"skill_sword", "skill_sword_tries"},
+		{"skill_axe", "skill_axe_tries"},
+		{"skill_dist", "skill_dist_tries"},
+		{"skill_shielding", "skill_shielding_tries"},
+		{"skill_fishing", "skill_fishing_tries"},
+	};
+	for (uint8_t i = SKILL_FIRST; i <= SKILL_LAST; ++i) {
+		stats.emplace_back(skillColumns[i][0], player->skills[i].level);
+		stats.emplace_back(skillColumns[i][1], player->skills[i].tries);
+	}
 
+	stats.emplace_back("blessings", player->blessings);
+
+	//the online time alone does not make the row worth rewriting; it is written as
+	//a total so that saves overlapping each other can't credit the same time twice
 	if (!player->isOffline()) {
-		query << "`onlinetime` = `onlinetime` + " << (time(nullptr) - player->lastLoginSaved) << ',';
+		snapshot.onlineTime = player->savedOnlineTime + (time(nullptr) - player->lastLoginSaved);
 	}
-	query << "`blessings` = " << static_cast<uint32_t>(player->blessings);
-	query << " WHERE `id` = " << player->getGUID();
 
-	DBTransaction transaction;
-	if (!transaction.begin()) {
-		return false;
+	uint64_t* digests = snapshot.digests;
+	digests[SAVESECTION_STATS] = fnv1aHash(snapshot.conditions.data(), snapshot.conditions.length());
+	for (const auto& it : stats) {
+		digests[SAVESECTION_STATS] = fnv1aHash(it.first, std::strlen(it.first) + 1, digests[SAVESECTION_STATS]);
+		digests[SAVESECTION_STATS] = fnv1aHash(reinterpret_cast<const char*>(&it.second), sizeof(it.second), digests[SAVESECTION_STATS]);
 	}
 
-	if (!db.executeQuery(query.str())) {
-		return false;
+	//serialize every section, only those that differ from the last save get written
+	std::vector<std::string>* sectionRows = snapshot.rows;
+	serializeItemSections(player, propWriteStream, sectionRows);
+
+	for (uint8_t section = SAVESECTION_INVENTORY; section <= SAVESECTION_INBOX; ++section) {
+		digests[section] = digestRows(sectionRows[section]);
 	}
 
-	query.str(std::string());
+	//storage values only write the keys changed since the last written save
+	player->genReservedStorageRange();
+	snapshot.storageStamp = player->storageMap.getChanges(snapshot.storageKeys);
+	std::vector<std::string>& storageRows = sectionRows[SAVESECTION_STORAGE];
+	for (uint32_t key : snapshot.storageKeys) {
+		int32_t value;
+		if (player->storageMap.get(key, value)) {
+			storageRows.emplace_back(std::to_string(player->getGUID()) + ',' + std::to_string(key) + ',' + std::to_string(value));
+		}
+	}
 
-	//item saving
-	query << "DELETE FROM `character_items` WHERE `character_id` = " << player->getGUID();
-	if (!db.executeQuery(query.str())) {
+	if (!player->storedItemsLoaded) {
+		// never read from the database, whatever is stored is still current
+		digests[SAVESECTION_DEPOT] = player->savedDigests[SAVESECTION_DEPOT];
+		digests[SAVESECTION_INBOX] = player->savedDigests[SAVESECTION_INBOX];
+	} else if (player->lastDepotId == -1) {
+		// the depot was never opened, whatever is stored is still current
+		digests[SAVESECTION_DEPOT] = player->savedDigests[SAVESECTION_DEPOT];
+	}
+
+	//a section is clean only if neither the last written nor a still pending snapshot differ
+	bool dirty = false;
+	for (uint8_t section = SAVESECTION_FIRST; section <= SAVESECTION_LAST; ++section) {
+		snapshot.dirty[section] = digests[section] != player->savedDigests[section] || digests[section] != player->snapshotDigests[section];
+		dirty = dirty || snapshot.dirty[section];
+	}
+
+	snapshot.dirty[SAVESECTION_STORAGE] = !snapshot.storageKeys.empty();
+	dirty = dirty || snapshot.dirty[SAVESECTION_STORAGE];
+
+	std::copy(digests, digests + SAVESECTION_LAST + 1, player->snapshotDigests);
+
+	if (!dirty) {
+		// the database already holds all of it
+		g_journal.addSaved(snapshot.guid, snapshot.sequence);
 		return false;
 	}
 
-	DBInsert itemsQuery("INSERT INTO `character_items` (`character_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ");
+	playerSaveOrder.addPending(snapshot.guid);
+	return true;
+}
 
+void IOLoginData::serializeItemSections(const Player* player, PropWriteStream& propWriteStream, std::vector<std::string>* sectionRows)
+{
 	ItemBlockList itemList;
 	for (int32_t slotId = 1; slotId <= 10; ++slotId) {
 		Item* item = player->inventory[slotId];
@@ -712,77 +1226,315 @@ bool IOLoginData::savePlayer(Player* player)
 			itemList.emplace_back(slotId, item);
 		}
 	}
+	serializeItems(player, itemList, propWriteStream, sectionRows[SAVESECTION_INVENTORY]);
 
-	if (!saveItems(player, itemList, itemsQuery, propWriteStream)) {
-		return false;
+	if (!player->storedItemsLoaded) {
+		return;
 	}
 
 	if (player->lastDepotId != -1) {
-		//save depot items
-		query.str(std::string());
-		query << "DELETE FROM `character_depotitems` WHERE `character_id` = " << player->getGUID();
-
-		if (!db.executeQuery(query.str())) {
-			return false;
-		}
-
-		DBInsert depotQuery("INSERT INTO `character_depotitems` (`character_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ");
 		itemList.clear();
-
 		for (const auto& it : player->depotChests) {
 			DepotChest* depotChest = it.second;
 			for (Item* item : depotChest->getItemList()) {
 				itemList.emplace_back(it.first, item);
 			}
 		}
+		serializeItems(player, itemList, propWriteStream, sectionRows[SAVESECTION_DEPOT]);
+	}
 
-		if (!saveItems(player, itemList, depotQuery, propWriteStream)) {
-			return false;
-		}
+	itemList.clear();
+	for (Item* item : player->inbox->getItemList()) {
+		itemList.emplace_back(0, item);
 	}
+	serializeItems(player, itemList, propWriteStream, sectionRows[SAVESECTION_INBOX]);
+}
 
-	//save inbox items
-	query.str(std::string());
-	query << "DELETE FROM `character_inboxitems` WHERE `character_id` = " << player->getGUID();
-	if (!db.executeQuery(query.str())) {
-		return false;
+uint64_t IOLoginData::digestRows(const std::vector<std::string>& rows)
+{
+	uint64_t digest = fnv1aHash(nullptr, 0);
+	for (const std::string& row : rows) {
+		// include the terminator so rows can't run into each other
+		digest = fnv1aHash(row.c_str(), row.length() + 1, digest);
 	}
+	return digest;
+}
 
-	DBInsert inboxQuery("INSERT INTO `character_inboxitems` (`character_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ");
-	itemList.clear();
+void IOLoginData::addLoadingPlayer(uint32_t guid)
+{
+	//dispatcher thread
+	++loadingPlayers[guid].logins;
+}
 
-	for (Item* item : player->getInbox()->getItemList()) {
-		itemList.emplace_back(0, item);
+void IOLoginData::removeLoadingPlayer(uint32_t guid)
+{
+	//dispatcher thread
+	auto it = loadingPlayers.find(guid);
+	if (it == loadingPlayers.end() || --it->second.logins != 0) {
+		return;
 	}
 
-	if (!saveItems(player, itemList, inboxQuery, propWriteStream)) {
-		return false;
+	// queued, so they run once the task that placed the player is done
+	for (auto& task : it->second.deferred) {
+		g_dispatcher.addTask(createTask(std::move(task)));
 	}
+	loadingPlayers.erase(it);
+}
 
-	query.str(std::string());
-	query << "DELETE FROM `character_storages` WHERE `character_id` = " << player->getGUID();
-	if (!db.executeQuery(query.str())) {
+bool IOLoginData::isLoadingPlayer(uint32_t guid)
+{
+	//dispatcher thread
+	return loadingPlayers.find(guid) != loadingPlayers.end();
+}
+
+bool IOLoginData::deferWhileLoading(uint32_t guid, std::function<void(void)> task)
+{
+	//dispatcher thread
+	auto it = loadingPlayers.find(guid);
+	if (it == loadingPlayers.end()) {
 		return false;
 	}
 
-	query.str(std::string());
+	it->second.deferred.push_back(std::move(task));
+	return true;
+}
 
-	DBInsert storageQuery("INSERT INTO `character_storages` (`character_id`, `key`, `value`) VALUES ");
-	player->genReservedStorageRange();
+void IOLoginData::journalPlayer(Player* player)
+{
+	//dispatcher thread
+	if (player->level != player->journaledLevel || player->experience != player->journaledExperience) {
+		player->journaledLevel = player->level;
+		player->journaledExperience = player->experience;
+		g_journal.addProgress(player->getGUID(), ++saveSequence, player->level, player->experience);
+	}
+
+	if (!player->itemsChanged) {
+		return;
+	}
+	player->itemsChanged = false;
+
+	PropWriteStream propWriteStream;
+	std::vector<std::string> sectionRows[SAVESECTION_LAST + 1];
+	serializeItemSections(player, propWriteStream, sectionRows);
+
+	uint64_t sequence = ++saveSequence;
+	for (uint8_t section = SAVESECTION_INVENTORY; section <= SAVESECTION_INBOX; ++section) {
+		if (section != SAVESECTION_INVENTORY && !player->storedItemsLoaded) {
+			break;
+		} else if (section == SAVESECTION_DEPOT && player->lastDepotId == -1) {
+			continue;
+		}
+
+		uint64_t digest = digestRows(sectionRows[section]);
+		if (digest != player->journaledDigests[section]) {
+			player->journaledDigests[section] = digest;
+			g_journal.addItems(player->getGUID(), sequence, static_cast<savesection_t>(section), std::move(sectionRows[section]));
+		}
+	}
+}
+
+bool IOLoginData::replayJournal()
+{
+	Database& db = Database::getInstance();
+	const std::map<uint32_t, JournalEntry>& entries = g_journal.getEntries();
+
+	// sequences are compared with the stored ones of earlier runs, so this
+	// run has to continue above all of them
+	DBResult_ptr result = db.storeQuery("SELECT MAX(`save_sequence`) AS `sequence` FROM `characters`");
+	uint64_t lastSequence = result ? result->getNumber<uint64_t>("sequence") : 0;
+	for (const auto& it : entries) {
+		for (uint64_t sequence : it.second.sequences) {
+			lastSequence = std::max(lastSequence, sequence);
+		}
+	}
+	saveSequence = lastSequence;
+
+	if (entries.empty()) {
+		return true;
+	}
 
-	for (const auto& it : player->storageMap) {
-		query << player->getGUID() << ',' << it.first << ',' << it.second;
-		if (!storageQuery.addRow(query)) {
+	for (const auto& it : entries) {
+		uint32_t guid = it.first;
+		const JournalEntry& entry = it.second;
+
+		DBTransaction transaction;
+		if (!transaction.begin()) {
+			return false;
+		}
+
+		DBStatement saveStmt = db.prepare("SELECT `save`, `save_sequence` FROM `characters` WHERE `id` = ?");
+		saveStmt.bind(guid);
+		if (!saveStmt.execute()) {
+			return false;
+		}
+
+		// deleted since, or not meant to be saved at all
+		if (!saveStmt.hasNext() || saveStmt.getNumber<uint16_t>(0) == 0) {
+			continue;
+		}
+
+		// the last committed save already holds everything journaled up to it
+		uint64_t savedSequence = saveStmt.getNumber<uint64_t>(1);
+		if (entry.sequences[SAVESECTION_STATS] > savedSequence) {
+			DBStatement stmt = db.prepare("UPDATE `characters` SET `level` = ?, `experience` = ? WHERE `id` = ?");
+			stmt.bind(entry.level).bind(entry.experience).bind(guid);
+			if (!stmt.execute()) {
+				return false;
+			}
+		}
+
+		for (uint8_t section = SAVESECTION_INVENTORY; section <= SAVESECTION_INBOX; ++section) {
+			if (entry.sequences[section] > savedSequence && !writeItemSection(guid, section, entry.rows[section])) {
+				return false;
+			}
+		}
+
+		if (!transaction.commit()) {
 			return false;
 		}
 	}
 
-	if (!storageQuery.execute()) {
+	std::cout << "> Replayed the journal of " << entries.size() << " players." << std::endl;
+	return true;
+}
+
+bool IOLoginData::writePlayerSnapshot(const PlayerSaveSnapshot& snapshot)
+{
+	return playerSaveOrder.write(snapshot.guid, snapshot.sequence, [&snapshot]() {
+		Database& db = Database::getInstance();
+
+		DBStatement saveStmt = db.prepare("SELECT `save` FROM `characters` WHERE `id` = ?");
+		saveStmt.bind(snapshot.guid);
+		if (!saveStmt.execute() || !saveStmt.hasNext()) {
+			return false;
+		}
+
+		if (saveStmt.getNumber<uint16_t>(0) == 0) {
+			DBStatement stmt = db.prepare("UPDATE `characters` SET `lastlogin` = ?, `lastip` = ? WHERE `id` = ?");
+			stmt.bind(snapshot.lastLoginSaved).bind(snapshot.lastIP).bind(snapshot.guid);
+			return stmt.execute();
+		}
+
+		DBTransaction transaction;
+		if (!transaction.begin()) {
+			return false;
+		}
+
+		if (snapshot.dirty[SAVESECTION_STATS]) {
+			//the statement text only varies with the optional columns so few variants get prepared
+			std::ostringstream query;
+			query << "UPDATE `characters` SET `conditions` = ?";
+			for (const auto& it : snapshot.stats) {
+				query << ", `" << it.first << "` = ?";
+			}
+			if (snapshot.onlineTime >= 0) {
+				query << ", `onlinetime` = ?";
+			}
+			query << " WHERE `id` = ?";
+
+			DBStatement stmt = db.prepare(query.str());
+			stmt.bind(snapshot.conditions);
+			for (const auto& it : snapshot.stats) {
+				stmt.bind(it.second);
+			}
+			if (snapshot.onlineTime >= 0) {
+				stmt.bind(snapshot.onlineTime);
+			}
+			stmt.bind(snapshot.guid);
+
+			if (!stmt.execute()) {
+				return false;
+			}
+		}
+
+		for (uint8_t section = SAVESECTION_INVENTORY; section <= SAVESECTION_INBOX; ++section) {
+			if (snapshot.dirty[section] && !writeItemSection(snapshot.guid, section, snapshot.rows[section])) {
+				return false;
+			}
+		}
+
+		if (snapshot.dirty[SAVESECTION_STORAGE] && !writeStorageChanges(snapshot.guid, snapshot.storageKeys, snapshot.rows[SAVESECTION_STORAGE])) {
+			return false;
+		}
+
+		// the replay skips whatever this save holds, committed along with it so
+		// that items which changed hands since can't come back after a crash
+		DBStatement sequenceStmt = db.prepare("UPDATE `characters` SET `save_sequence` = ? WHERE `id` = ?");
+		sequenceStmt.bind(snapshot.sequence).bind(snapshot.guid);
+		if (!sequenceStmt.execute()) {
+			return false;
+		}
+
+		//End the transaction
+		if (!transaction.commit()) {
+			return false;
+		}
+
+		// only trims the journal, the next periodic sync flushes it
+		g_journal.addSaved(snapshot.guid, snapshot.sequence);
+		return true;
+	});
+}
+
+bool IOLoginData::writeItemSection(uint32_t guid, uint8_t section, const std::vector<std::string>& rows)
+{
+	static const char* const sectionTables[SAVESECTION_INBOX + 1] = {"characters", "character_items", "character_depotitems", "character_inboxitems"};
+
+	Database& db = Database::getInstance();
+
+	const std::string table = sectionTables[section];
+	DBStatement deleteStmt = db.prepare("DELETE FROM `" + table + "` WHERE `character_id` = ?");
+	deleteStmt.bind(guid);
+	if (!deleteStmt.execute()) {
 		return false;
 	}
 
-	//End the transaction
-	return transaction.commit();
+	DBInsert insertQuery("INSERT INTO `" + table + "` (`character_id`, `pid`, `sid`, `itemtype`, `count`, `attributes`) VALUES ");
+	for (const std::string& row : rows) {
+		if (!insertQuery.addRow(row)) {
+			return false;
+		}
+	}
+	return insertQuery.execute();
+}
+
+bool IOLoginData::writeStorageChanges(uint32_t guid, const std::vector<uint32_t>& keys, const std::vector<std::string>& rows)
+{
+	Database& db = Database::getInstance();
+
+	//erased keys only need the delete, the others get inserted again
+	std::ostringstream query;
+	query << "DELETE FROM `character_storages` WHERE `character_id` = " << guid << " AND `key` IN (";
+	for (size_t i = 0; i < keys.size(); ++i) {
+		if (i != 0) {
+			query << ',';
+		}
+		query << keys[i];
+	}
+	query << ')';
+	if (!db.executeQuery(query.str())) {
+		return false;
+	}
+
+	DBInsert insertQuery("INSERT INTO `character_storages` (`character_id`, `key`, `value`) VALUES ");
+	for (const std::string& row : rows) {
+		if (!insertQuery.addRow(row)) {
+			return false;
+		}
+	}
+	return insertQuery.execute();
+}
+
+void IOLoginData::adoptPlayerSnapshot(Player* player, const PlayerSaveSnapshot& snapshot)
+{
+	// a newer save already went through, or the player was loaded again since
+	if (snapshot.sequence <= player->savedSequence) {
+		return;
+	}
+
+	player->savedSequence = snapshot.sequence;
+	std::copy(snapshot.digests, snapshot.digests + SAVESECTION_LAST + 1, player->savedDigests);
+	player->storageMap.clearChanges(snapshot.storageStamp);
 }
 
 std::string IOLoginData::getNameByGuid(uint32_t guid)
@@ -851,16 +1603,16 @@ bool IOLoginData::formatPlayerName(std::string& name)
 	return true;
 }
 
-void IOLoginData::loadItems(ItemMap& itemMap, DBResult_ptr result)
+void IOLoginData::loadItems(ItemMap& itemMap, DBStatement& result)
 {
 	do {
-		uint32_t sid = result->getNumber<uint32_t>("sid");
-		uint32_t pid = result->getNumber<uint32_t>("pid");
-		uint16_t type = result->getNumber<uint16_t>("itemtype");
-		uint16_t count = result->getNumber<uint16_t>("count");
+		uint32_t sid = result.getNumber<uint32_t>(ITEM_SID);
+		uint32_t pid = result.getNumber<uint32_t>(ITEM_PID);
+		uint16_t type = result.getNumber<uint16_t>(ITEM_TYPE);
+		uint16_t count = result.getNumber<uint16_t>(ITEM_COUNT);
 
 		unsigned long attrSize;
-		const char* attr = result->getStream("attributes", attrSize);
+		const char* attr = result.getStream(ITEM_ATTRIBUTES, attrSize);
 
 		PropStream propStream;
 		propStream.init(attr, attrSize);
@@ -874,11 +1626,23 @@ void IOLoginData::loadItems(ItemMap& itemMap, DBResult_ptr result)
 			std::pair<Item*, uint32_t> pair(item, pid);
 			itemMap[sid] = pair;
 		}
-	} while (result->next());
+	} while (result.next());
 }
 
 void IOLoginData::increaseBankBalance(uint32_t guid, uint64_t bankBalance)
 {
+	//dispatcher thread
+	bool deferred = deferWhileLoading(guid, [guid, bankBalance]() {
+		if (Player* player = g_game.getPlayerByGUID(guid)) {
+			player->setBankBalance(player->getBankBalance() + bankBalance);
+		} else {
+			increaseBankBalance(guid, bankBalance);
+		}
+	});
+	if (deferred) {
+		return;
+	}
+
 	std::ostringstream query;
 	query << "UPDATE `characters` SET `balance` = `balance` + " << bankBalance << " WHERE `id` = " << guid;
 	Database::getInstance().executeQuery(query.str());
@@ -956,45 +1720,68 @@ void IOLoginData::removePremiumDays(uint32_t accountId, int32_t removeDays)
 
 bool IOLoginData::loadPokemonById(Pokemon* pokemon, uint32_t id)
 {
-	Database& db = Database::getInstance();
-	std::ostringstream query;
-	query << "SELECT `id`, `pokeball`, `type`, `shiny`, `nickname`, `gender`, `nature`, `hpnow`, `hp`, `atk`, `def`, `speed`, `spatk`, `spdef`, `conditions`, `moves`, `abilities` FROM `pokemon` WHERE `id` = " << id;
-	return loadPokemon(pokemon, db.storeQuery(query.str()));
+	DBStatement stmt = Database::getInstance().prepare(POKEMON_SELECT);
+	stmt.bind(id);
+	if (!stmt.execute() || !stmt.hasNext()) {
+		return false;
+	}
+	return loadPokemon(pokemon, stmt);
 }
 
-bool IOLoginData::loadPokemon(Pokemon* pokemon, DBResult_ptr result)
+void IOLoginData::loadPokemonsById(const std::vector<uint32_t>& guids, std::vector<Pokemon*>& pokemons)
 {
-	if (!result) {
-		return false;
+	for (uint32_t guid : guids) {
+		Pokemon* pokemon = new Pokemon();
+		if (loadPokemonById(pokemon, guid)) {
+			pokemons.push_back(pokemon);
+		} else {
+			delete pokemon;
+		}
 	}
+}
 
-	const PokeballType* pokeballType = g_pokeballs->getPokeballTypeByServerID(result->getNumber<uint16_t>("pokeball"));
+void IOLoginData::loadItemPokemons(const ItemMap& itemMap, std::vector<Pokemon*>& pokemons)
+{
+	std::vector<uint32_t> guids;
+	for (const auto& it : itemMap) {
+		uint32_t pokemonId = it.second.first->getPokemonId();
+		if (pokemonId != 0) {
+			guids.push_back(pokemonId);
+		}
+	}
+	loadPokemonsById(guids, pokemons);
+}
+
+bool IOLoginData::loadPokemon(Pokemon* pokemon, DBStatement& result)
+{
+	const PokeballType* pokeballType = g_pokeballs->getPokeballTypeByServerID(result.getNumber<uint16_t>(POKEMON_POKEBALL));
 	if (!pokeballType) {
 		return false;
 	}
 
-	PokemonType* pokemonType = g_pokemons.getPokemonType(result->getString("type"));
+	PokemonType* pokemonType = g_pokemons.getPokemonType(result.getString(POKEMON_TYPE));
 	if (!pokemonType) {
 		return false;
 	}
 
-	pokemon->setGUID(result->getNumber<uint64_t>("id"));
+	pokemon->setGUID(result.getNumber<uint64_t>(POKEMON_ID));
 	pokemon->setPokeballType(pokeballType);
 	pokemon->setPokemonType(pokemonType);
-	pokemon->setShinyStatus(result->getNumber<uint16_t>("shiny"));
-	pokemon->setName(result->getString("nickname"));
-	pokemon->setGender(static_cast<Genders_t>(result->getNumber<uint16_t>("gender")));
-	pokemon->setNature(static_cast<Natures_t>(result->getNumber<uint16_t>("nature")));
-	pokemon->setIVHP(result->getNumber<uint16_t>("hp"));
-	pokemon->setIVAttack(result->getNumber<uint16_t>("atk"));
-	pokemon->setIVDefense(result->getNumber<uint16_t>("def"));
-	pokemon->setIVSpeed(result->getNumber<uint16_t>("speed"));
-	pokemon->setIVSpecialAttack(result->getNumber<uint16_t>("spatk"));
-	pokemon->setIVSpecialDefense(result->getNumber<uint16_t>("spdef"));
-	pokemon->setAbilities(result->getNumber<uint32_t>("abilities"));
+	pokemon->setShinyStatus(result.getNumber<uint16_t>(POKEMON_SHINY));
+	pokemon->setName(result.getString(POKEMON_NICKNAME));
+	pokemon->setGender(static_cast<Genders_t>(result.getNumber<uint16_t>(POKEMON_GENDER)));
+	pokemon->setNature(static_cast<Natures_t>(result.getNumber<uint16_t>(POKEMON_NATURE)));
+	pokemon->setIVHP(result.getNumber<uint16_t>(POKEMON_HP));
+	pokemon->setIVAttack(result.getNumber<uint16_t>(POKEMON_ATK));
+	pokemon->setIVDefense(result.getNumber<uint16_t>(POKEMON_DEF));
+	pokemon->setIVSpeed(result.getNumber<uint16_t>(POKEMON_SPEED));
+	pokemon->setIVSpecialAttack(result.getNumber<uint16_t>(POKEMON_SPATK));
+	pokemon->setIVSpecialDefense(result.getNumber<uint16_t>(POKEMON_SPDEF));
+	pokemon->setAbilities(result.getNumber<uint32_t>(POKEMON_ABILITIES));
 	//load hp
-	pokemon->health = result->getNumber<int32_t>("hpnow");
+	pokemon->health = result.getNumber<int32_t>(POKEMON_HPNOW);
 	pokemon->persistent = true;
+	pokemon->lastSaveTime = OTSYS_TIME();
 
 	if (pokemon->getShinyStatus() && (pokemon->getPokemonType()->info.shiny.outfit.lookType)) {
 		pokemon->setCurrentOutfit(pokemon->getPokemonType()->info.shiny.outfit);
@@ -1006,7 +1793,7 @@ bool IOLoginData::loadPokemon(Pokemon* pokemon, DBResult_ptr result)
 
 	// load conditions
 	unsigned long conditionsSize;
-	const char* conditions = result->getStream("conditions", conditionsSize);
+	const char* conditions = result.getStream(POKEMON_CONDITIONS, conditionsSize);
 	PropStream propStream;
 	propStream.init(conditions, conditionsSize);
 
@@ -1022,7 +1809,7 @@ bool IOLoginData::loadPokemon(Pokemon* pokemon, DBResult_ptr result)
 
 	// load moves
 	unsigned long movesSize;
-	const char* moves = result->getStream("moves", movesSize);
+	const char* moves = result.getStream(POKEMON_MOVES, movesSize);
 	PropStream movePropStream;
 	movePropStream.init(moves, movesSize);
 
@@ -1041,11 +1828,97 @@ bool IOLoginData::loadPokemon(Pokemon* pokemon, DBResult_ptr result)
 
 bool IOLoginData::savePokemon(Pokemon* pokemon)
 {
+	if (pokemon->getGUID() != 0) {
+		return savePokemons({pokemon});
+	}
+
+	// a new pokemon needs its id right away
+	PokemonSaveSnapshot snapshot;
+	if (!snapshotPokemon(pokemon, snapshot)) {
+		return false;
+	}
+
 	Database& db = Database::getInstance();
+	DBStatement stmt = db.prepare("INSERT INTO `pokemon` (`pokeball`, `type`, `shiny`, `nickname`, `gender`, `nature`, `hpnow`, `hp`, `atk`, `def`, `speed`, `spatk`, `spdef`, `conditions`, `moves`, `abilities`) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+	stmt.bind(snapshot.pokeball);
+	stmt.bind(snapshot.typeName);
+	stmt.bind(snapshot.shiny);
+	stmt.bind(snapshot.nickname);
+	stmt.bind(snapshot.gender);
+	stmt.bind(snapshot.nature);
+	stmt.bind(snapshot.health);
+	for (uint8_t iv : snapshot.ivs) {
+		stmt.bind(iv);
+	}
+	stmt.bind(snapshot.conditions);
+	stmt.bind(snapshot.moves);
+	stmt.bind(snapshot.abilities);
+	if (!stmt.execute()) {
+		return false;
+	}
 
-	std::ostringstream query;
-	query << "SELECT `id` FROM `pokemon` WHERE `id` = " << pokemon->getGUID();
-	DBResult_ptr result = db.storeQuery(query.str());
+	pokemon->setGUID(stmt.getLastInsertId());
+	return true;
+}
+
+bool IOLoginData::savePokemons(const std::vector<Pokemon*>& pokemons)
+{
+	std::vector<PokemonSaveSnapshot> snapshots;
+	if (!snapshotPokemons(pokemons, snapshots)) {
+		return true;
+	}
+	return writePokemonSnapshots(snapshots);
+}
+
+bool IOLoginData::savePokemonsAsync(const std::vector<Pokemon*>& pokemons, std::function<void(bool)> callback/* = nullptr*/)
+{
+	auto snapshots = std::make_shared<std::vector<PokemonSaveSnapshot>>();
+	if (!snapshotPokemons(pokemons, *snapshots)) {
+		return false;
+	}
+
+	g_databaseTasks.addWork([snapshots, callback]() {
+		//database task thread
+		bool saved = writePokemonSnapshots(*snapshots);
+		if (callback) {
+			callback(saved);
+		}
+	}, DATABASE_ORDER_POKEMON);
+	return true;
+}
+
+bool IOLoginData::snapshotPokemons(const std::vector<Pokemon*>& pokemons, std::vector<PokemonSaveSnapshot>& snapshots)
+{
+	snapshots.reserve(pokemons.size());
+	for (Pokemon* pokemon : pokemons) {
+		// only stored pokemon can be written in bulk, new ones need an id first
+		if (pokemon->getGUID() == 0) {
+			continue;
+		}
+
+		snapshots.emplace_back();
+		if (!snapshotPokemon(pokemon, snapshots.back())) {
+			snapshots.pop_back();
+		} else {
+			pokemonSaveOrder.addPending(pokemon->getGUID());
+		}
+	}
+	return !snapshots.empty();
+}
+
+bool IOLoginData::snapshotPokemon(Pokemon* pokemon, PokemonSaveSnapshot& snapshot)
+{
+	const PokeballType* pbType = pokemon->getPokeballType();
+	if (!pbType) {
+		return false;
+	}
+
+	pokemon->lastSaveTime = OTSYS_TIME();
+
+	snapshot.guid = pokemon->getGUID();
+	snapshot.sequence = ++saveSequence;
+	snapshot.typeName = pokemon->getPokemonType()->typeName;
+	snapshot.nickname = pokemon->getName();
 
 	//serialize conditions
 	PropWriteStream propWriteStream;
@@ -1058,6 +1931,7 @@ bool IOLoginData::savePokemon(Pokemon* pokemon)
 
 	size_t conditionsSize;
 	const char* conditions = propWriteStream.getStream(conditionsSize);
+	snapshot.conditions.assign(conditions, conditionsSize);
 
 	//serialize moves
 	propWriteStream.clear();
@@ -1075,67 +1949,44 @@ bool IOLoginData::savePokemon(Pokemon* pokemon)
 
 	size_t movesSize;
 	const char* moves = propWriteStream.getStream(movesSize);
+	snapshot.moves.assign(moves, movesSize);
+
+	snapshot.pokeball = pbType->getServerID();
+	snapshot.shiny = pokemon->getShinyStatus();
+	snapshot.gender = pokemon->getGender();
+	snapshot.nature = pokemon->getNature();
+	snapshot.health = pokemon->getHealth();
+	snapshot.ivs[0] = pokemon->getIVHP();
+	snapshot.ivs[1] = pokemon->getIVAttack();
+	snapshot.ivs[2] = pokemon->getIVDefense();
+	snapshot.ivs[3] = pokemon->getIVSpeed();
+	snapshot.ivs[4] = pokemon->getIVSpecialAttack();
+	snapshot.ivs[5] = pokemon->getIVSpecialDefense();
+	snapshot.abilities = pokemon->getAbilities();
+	return true;
+}
 
-	const PokeballType* pbType = pokemon->getPokeballType();
-	if (!pbType) {
-		return false;
-	}
-
-	query.str(std::string());
-	if (result) {
-		query << "UPDATE `pokemon` SET ";
-		query << "`pokeball` = " << pbType->getServerID() << ',';
-		query << "`type` = '" << pokemon->getPokemonType()->typeName << "',";
-		query << "`shiny` = " << pokemon->getShinyStatus() << ',';
-		query << "`nickname` = '" << pokemon->getName() << "',";
-		query << "`gender` = " << pokemon->getGender() << ',';
-		query << "`nature` = " << pokemon->getNature() << ',';
-		query << "`hpnow` = " << pokemon->getHealth() << ',';
-		query << "`hp` = " << static_cast<uint32_t>(pokemon->getIVHP()) << ',';
-		query << "`atk` = " << static_cast<uint32_t>(pokemon->getIVAttack()) << ',';
-		query << "`def` = " << static_cast<uint32_t>(pokemon->getIVDefense()) << ',';
-		query << "`speed` = " << static_cast<uint32_t>(pokemon->getIVSpeed()) << ',';
-		query << "`spatk` = " << static_cast<uint32_t>(pokemon->getIVSpecialAttack()) << ',';
-		query << "`spdef` = " << static_cast<uint32_t>(pokemon->getIVSpecialDefense()) << ',';
-
-		query << "`conditions` = " << db.escapeBlob(conditions, conditionsSize) << ',';
-		query << "`moves` = " << db.escapeBlob(moves, movesSize) << ',';
-
-		query << "`abilities` = " << pokemon->getAbilities();
-
-		query << " WHERE `id` = " << pokemon->getGUID();
-
-		if (!db.executeQuery(query.str())) {
-			return false;
-		}
-	} else {
-		query << "INSERT INTO `pokemon` (`id`, `pokeball`, `type`, `shiny`, `nickname`, `gender`, `nature`, `hpnow`, `hp`, `atk`, `def`, `speed`, `spatk`, `spdef`, `conditions`, `moves`, `abilities`) VALUES (";
-		query << (pokemon->getGUID() ? pokemon->getGUID() : 0) << ',';
-		query << pbType->getServerID() << ',';
-		query << '\'' << pokemon->getPokemonType()->typeName << "',";
-		query << pokemon->getShinyStatus() << ',';
-		query << '\'' << pokemon->getName() <<  "',";
-		query << pokemon->getGender() << ',';
-		query << pokemon->getNature() << ',';
-		query << pokemon->getHealth() << ',';
-		query << static_cast<uint32_t>(pokemon->getIVHP()) << ',';
-		query << static_cast<uint32_t>(pokemon->getIVAttack()) << ',';
-		query << static_cast<uint32_t>(pokemon->getIVDefense()) << ',';
-		query << static_cast<uint32_t>(pokemon->getIVSpeed()) << ',';
-		query << static_cast<uint32_t>(pokemon->getIVSpecialAttack()) << ',';
-		query << static_cast<uint32_t>(pokemon->getIVSpecialDefense()) << ',';
-
-		query << db.escapeBlob(conditions, conditionsSize) << ',';
-		query << db.escapeBlob(moves, movesSize) << ',';
-
-		query << pokemon->getAbilities() << ')';
-
-		if (!db.executeQuery(query.str())) {
-			return false;
+bool IOLoginData::writePokemonSnapshots(const std::vector<PokemonSaveSnapshot>& snapshots)
+{
+	return pokemonSaveOrder.writeBatch(snapshots, [](const std::vector<const PokemonSaveSnapshot*>& current) {
+		Database& db = Database::getInstance();
+
+		DBInsert upsert("INSERT INTO `pokemon` (`id`, `pokeball`, `type`, `shiny`, `nickname`, `gender`, `nature`, `hpnow`, `hp`, `atk`, `def`, `speed`, `spatk`, `spdef`, `conditions`, `moves`, `abilities`) VALUES ");
+		upsert.upsert({"pokeball", "type", "shiny", "nickname", "gender", "nature", "hpnow", "hp", "atk", "def", "speed", "spatk", "spdef", "conditions", "moves", "abilities"});
+
+		std::ostringstream row;
+		for (const PokemonSaveSnapshot* snapshot : current) {
+			row << snapshot->guid << ',' << snapshot->pokeball << ',' << db.escapeString(snapshot->typeName) << ',' << snapshot->shiny << ',';
+			row << db.escapeString(snapshot->nickname) << ',' << static_cast<uint32_t>(snapshot->gender) << ',' << static_cast<uint32_t>(snapshot->nature) << ',' << snapshot->health << ',';
+			for (uint8_t iv : snapshot->ivs) {
+				row << static_cast<uint32_t>(iv) << ',';
+			}
+			row << db.escapeBlob(snapshot->conditions.data(), snapshot->conditions.length()) << ',';
+			row << db.escapeBlob(snapshot->moves.data(), snapshot->moves.length()) << ',' << snapshot->abilities;
+			if (!upsert.addRow(row)) {
+				return false;
+			}
 		}
-
-		pokemon->setGUID(db.getLastInsertId());
-	}
-
-	return true;
-}
\ No newline at end of file
+		return upsert.execute();
+	});
+}
@@ -34,6 +34,41 @@ extern Pokemons g_pokemons;
 
 using ItemBlockList = std::list<std::pair<int32_t, Item*>>;
 
+/**
+ * Copy of everything savePlayer writes, taken on the dispatcher so the
+ * writes themselves can run on any thread.
+ */
+struct PlayerSaveSnapshot {
+	std::vector<std::pair<const char*, int64_t>> stats; // `characters` column and value
+	std::string conditions;
+	std::vector<std::string> rows[SAVESECTION_LAST + 1]; // the stats section has none
+	uint64_t digests[SAVESECTION_LAST + 1] = {};
+	bool dirty[SAVESECTION_LAST + 1] = {};
+	std::vector<uint32_t> storageKeys; // changed since the last written save, rows holds those still set
+	uint64_t storageStamp = 0;
+	uint64_t sequence = 0;
+	int64_t onlineTime = -1;
+	time_t lastLoginSaved = 0;
+	uint32_t lastIP = 0;
+	uint32_t guid = 0;
+};
+
+struct PokemonSaveSnapshot {
+	std::string typeName;
+	std::string nickname;
+	std::string conditions;
+	std::string moves;
+	uint64_t sequence = 0;
+	uint32_t guid = 0;
+	uint32_t abilities = 0;
+	int32_t health = 0;
+	uint16_t pokeball = 0;
+	uint8_t ivs[6] = {};
+	uint8_t gender = 0;
+	uint8_t nature = 0;
+	bool shiny = false;
+};
+
 class IOLoginData
 {
 	public:
@@ -48,10 +83,52 @@ class IOLoginData
 		static void updateOnlineStatus(uint32_t guid, bool login);
 		static bool preloadPlayer(Player* player, const std::string& name);
 
-		static bool loadPlayerById(Player* player, uint32_t id);
+		/**
+		 * detached loads run off the dispatcher for players logging in:
+		 * the guild gets bound later and the depot and inbox items are
+		 * left for loadStoredItemsAsync.
+		 */
+		static bool loadPlayerById(Player* player, uint32_t id, bool detached = false);
 		static bool loadPlayerByName(Player* player, const std::string& name);
-		static bool loadPlayer(Player* player, DBResult_ptr result);
+		static bool loadPlayer(Player* player, DBStatement& result, bool detached = false);
+		static void bindPlayerGuild(Player* player);
 		static bool savePlayer(Player* player);
+
+		/**
+		 * Serializes the player now and writes it on a database task
+		 * thread; callback runs there too once the write is done.
+		 *
+		 * @return false when there was nothing to write
+		 */
+		static bool savePlayerAsync(Player* player, std::function<void(bool)> callback = nullptr);
+
+		/**
+		 * Reads the depot and inbox items of a player that logged in without
+		 * them; callback runs on the dispatcher once they are in, whether the
+		 * player is still online by then or not, and also when they could not
+		 * be read.
+		 */
+		static void loadStoredItemsAsync(Player* player, std::function<void(void)> callback = nullptr);
+		// false when they could not be read, the player is left without them then
+		static bool loadStoredItems(Player* player);
+		// drops the depot and inbox items again if the database holds all of them
+		static bool unloadStoredItems(Player* player);
+
+		/**
+		 * Players the login is reading, dispatcher thread. A copy read before
+		 * an offline change would overwrite it with its first save, so those
+		 * changes wait until the player is placed or turned away.
+		 */
+		static void addLoadingPlayer(uint32_t guid);
+		static void removeLoadingPlayer(uint32_t guid);
+		static bool isLoadingPlayer(uint32_t guid);
+		// false when the player is not being loaded, the caller goes on right away then
+		static bool deferWhileLoading(uint32_t guid, std::function<void(void)> task);
+
+		// records what changed since the last call in the journal
+		static void journalPlayer(Player* player);
+		static bool replayJournal();
+
 		static uint32_t getGuidByName(const std::string& name);
 		static bool getGuidByNameEx(uint32_t& guid, bool& specialVip, std::string& name);
 		static std::string getNameByGuid(uint32_t guid);
@@ -68,13 +145,41 @@ class IOLoginData
 		static void removePremiumDays(uint32_t accountId, int32_t removeDays);
 
 		static bool loadPokemonById(Pokemon* pokemon, uint32_t id);
-		static bool loadPokemon(Pokemon* pokemon, DBResult_ptr result);
+		// any thread, the pokemon still have to be handed to Game::addLoadedPokemons
+		static void loadPokemonsById(const std::vector<uint32_t>& guids, std::vector<Pokemon*>& pokemons);
+		static bool loadPokemon(Pokemon* pokemon, DBStatement& result);
 		static bool savePokemon(Pokemon* pokemon);
+
+		// stored pokemon only, all of them in as few statements as possible
+		static bool savePokemons(const std::vector<Pokemon*>& pokemons);
+		static bool savePokemonsAsync(const std::vector<Pokemon*>& pokemons, std::function<void(bool)> callback = nullptr);
 	private:
 		using ItemMap = std::map<uint32_t, std::pair<Item*, uint32_t>>;
 
-		static void loadItems(ItemMap& itemMap, DBResult_ptr result);
-		static bool saveItems(const Player* player, const ItemBlockList& itemList, DBInsert& query_insert, PropWriteStream& propWriteStream);
+		static void loadItems(ItemMap& itemMap, DBStatement& result);
+		static bool readStoredItems(uint32_t guid, ItemMap& depotItems, ItemMap& inboxItems, std::vector<Pokemon*>* pokemons = nullptr);
+		static void loadItemPokemons(const ItemMap& itemMap, std::vector<Pokemon*>& pokemons);
+		static void attachStoredItems(Player* player, const ItemMap& depotItems, const ItemMap& inboxItems);
+		static bool snapshotPlayer(Player* player, PlayerSaveSnapshot& snapshot);
+		static bool writePlayerSnapshot(const PlayerSaveSnapshot& snapshot);
+		static void adoptPlayerSnapshot(Player* player, const PlayerSaveSnapshot& snapshot);
+		static bool snapshotPokemon(Pokemon* pokemon, PokemonSaveSnapshot& snapshot);
+		static bool snapshotPokemons(const std::vector<Pokemon*>& pokemons, std::vector<PokemonSaveSnapshot>& snapshots);
+		static bool writePokemonSnapshots(const std::vector<PokemonSaveSnapshot>& snapshots);
+		static void serializeItems(const Player* player, const ItemBlockList& itemList, PropWriteStream& propWriteStream, std::vector<std::string>& rows);
+		static void serializeItemSections(const Player* player, PropWriteStream& propWriteStream, std::vector<std::string>* sectionRows);
+		static uint64_t digestRows(const std::vector<std::string>& rows);
+		static bool writeItemSection(uint32_t guid, uint8_t section, const std::vector<std::string>& rows);
+		static bool writeStorageChanges(uint32_t guid, const std::vector<uint32_t>& keys, const std::vector<std::string>& rows);
+
+		static std::atomic<uint64_t> saveSequence;
+		static std::map<uint32_t, std::vector<std::function<void(void)>>> storedItemsCallbacks; // dispatcher thread, players being read
+
+		struct LoadingPlayer {
+			uint32_t logins = 0;
+			std::vector<std::function<void(void)>> deferred;
+		};
+		static std::map<uint32_t, LoadingPlayer> loadingPlayers; // dispatcher thread
 };
 
 #endif
@@ -20,6 +20,8 @@
 
 #include "otpch.h"
 
+#include <atomic>
+
 #include "iomapserialize.h"
 #include "game.h"
 #include "bed.h"
@@ -30,43 +32,83 @@ void IOMapSerialize::loadHouseItems(Map* map)
 {
 	int64_t start = OTSYS_TIME();
 
-	DBResult_ptr result = Database::getInstance().storeQuery("SELECT `data` FROM `tile_store`");
-	if (!result) {
+	// every house tile of the map, grouped by house
+	std::map<uint32_t, std::vector<std::string>> houseData;
+	if (DBResult_ptr result = Database::getInstance().streamQuery("SELECT `house_id`, `data` FROM `tile_store`")) {
+		const size_t houseIdColumn = result->getColumn("house_id");
+		const size_t dataColumn = result->getColumn("data");
+		do {
+			unsigned long attrSize;
+			const char* attr = result->getStream(dataColumn, attrSize);
+			houseData[result->getNumber<uint32_t>(houseIdColumn)].emplace_back(attr, attrSize);
+		} while (result->next());
+	}
+
+	if (houseData.empty()) {
 		return;
 	}
 
-	do {
-		unsigned long attrSize;
-		const char* attr = result->getStream("data", attrSize);
+	int64_t readTime = OTSYS_TIME();
 
-		PropStream propStream;
-		propStream.init(attr, attrSize);
+	// the houses do not share anything, so their items are built on as many
+	// threads as there are cores and only attached to the map on this one
+	std::vector<const std::vector<std::string>*> houses;
+	houses.reserve(houseData.size());
+	for (const auto& it : houseData) {
+		houses.push_back(&it.second);
+	}
 
-		uint16_t x, y;
-		uint8_t z;
-		if (!propStream.read<uint16_t>(x) || !propStream.read<uint16_t>(y) || !propStream.read<uint8_t>(z)) {
-			continue;
+	std::vector<std::vector<LoadedTile>> loadedHouses(houses.size());
+	std::atomic<size_t> nextHouse(0);
+	auto parseHouses = [&]() {
+		for (size_t i = nextHouse++; i < houses.size(); i = nextHouse++) {
+			for (const std::string& data : *houses[i]) {
+				parseTile(data, loadedHouses[i]);
+			}
 		}
+	};
 
-		Tile* tile = map->getTile(x, y, z);
-		if (!tile) {
-			continue;
-		}
+	size_t threadCount = std::min<size_t>(std::max<size_t>(std::thread::hardware_concurrency(), 1), houses.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < threadCount; ++i) {
+		threads.emplace_back(parseHouses);
+	}
+	parseHouses();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
 
-		uint32_t item_count;
-		if (!propStream.read<uint32_t>(item_count)) {
-			continue;
-		}
+	int64_t parseTime = OTSYS_TIME();
+
+	for (std::vector<LoadedTile>& loadedTiles : loadedHouses) {
+		for (LoadedTile& loadedTile : loadedTiles) {
+			Tile* tile = map->getTile(loadedTile.position);
+			if (!tile) {
+				continue;
+			}
 
-		while (item_count--) {
-			loadItem(propStream, tile);
+			for (std::unique_ptr<Item>& item : loadedTile.items) {
+				tile->internalAddThing(item.get());
+				item.release()->startDecaying();
+			}
+
+			while (loadedTile.restCount--) {
+				loadItem(loadedTile.rest, tile);
+			}
 		}
-	} while (result->next());
-	std::cout << "> Loaded house items in: " << (OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
+	}
+
+	int64_t end = OTSYS_TIME();
+	std::cout << "> Loaded house items in: " << (end - start) / (1000.) << " s (read " << (readTime - start) / (1000.) << " s, parse "
+	          << (parseTime - readTime) / (1000.) << " s on " << threadCount << " threads, attach " << (end - parseTime) / (1000.) << " s)" << std::endl;
 }
 
-bool IOMapSerialize::saveHouseItems()
+bool IOMapSerialize::saveHouseItems(const HouseSaveSnapshot& snapshot)
 {
+	if (snapshot.changedHouses.empty()) {
+		return true;
+	}
+
 	int64_t start = OTSYS_TIME();
 	Database& db = Database::getInstance();
 	std::ostringstream query;
@@ -77,29 +119,27 @@ bool IOMapSerialize::saveHouseItems()
 		return false;
 	}
 
-	//clear old tile data
-	if (!db.executeQuery("DELETE FROM `tile_store`")) {
+	//clear old tile data of the changed houses
+	query << "DELETE FROM `tile_store` WHERE `house_id` IN (";
+	for (size_t i = 0; i < snapshot.changedHouses.size(); ++i) {
+		if (i != 0) {
+			query << ',';
+		}
+		query << snapshot.changedHouses[i];
+	}
+	query << ')';
+
+	if (!db.executeQuery(query.str())) {
 		return false;
 	}
+	query.str(std::string());
 
 	DBInsert stmt("INSERT INTO `tile_store` (`house_id`, `data`) VALUES ");
 
-	PropWriteStream stream;
-	for (const auto& it : g_game.map.houses.getHouses()) {
-		//save house items
-		House* house = it.second;
-		for (HouseTile* tile : house->getTiles()) {
-			saveTile(stream, tile);
-
-			size_t attributesSize;
-			const char* attributes = stream.getStream(attributesSize);
-			if (attributesSize > 0) {
-				query << house->getId() << ',' << db.escapeBlob(attributes, attributesSize);
-				if (!stmt.addRow(query)) {
-					return false;
-				}
-				stream.clear();
-			}
+	for (const auto& tile : snapshot.tiles) {
+		query << tile.first << ',' << db.escapeBlob(tile.second.data(), tile.second.length());
+		if (!stmt.addRow(query)) {
+			return false;
 		}
 	}
 
@@ -109,11 +149,95 @@ bool IOMapSerialize::saveHouseItems()
 
 	//End the transaction
 	bool success = transaction.commit();
-	std::cout << "> Saved house items in: " <<
+	std::cout << "> Saved items of " << snapshot.changedHouses.size() << " houses in: " <<
 	          (OTSYS_TIME() - start) / (1000.) << " s" << std::endl;
 	return success;
 }
 
+void IOMapSerialize::parseTile(const std::string& data, std::vector<LoadedTile>& tiles)
+{
+	//house item loader thread
+	PropStream propStream;
+	propStream.init(data.data(), data.size());
+
+	uint16_t x, y;
+	uint8_t z;
+	if (!propStream.read<uint16_t>(x) || !propStream.read<uint16_t>(y) || !propStream.read<uint8_t>(z)) {
+		return;
+	}
+
+	uint32_t item_count;
+	if (!propStream.read<uint32_t>(item_count)) {
+		return;
+	}
+
+	tiles.emplace_back();
+	LoadedTile& tile = tiles.back();
+	tile.position = Position(x, y, z);
+
+	while (item_count > 0) {
+		PropStream itemStream = propStream;
+		Item* item = parseItem(propStream, true);
+		if (!item) {
+			// leave the rest of the tile to loadItem, in the order it was saved
+			tile.rest = itemStream;
+			tile.restCount = item_count;
+			return;
+		}
+
+		tile.items.emplace_back(item);
+		--item_count;
+	}
+}
+
+Item* IOMapSerialize::parseItem(PropStream& propStream, bool onTile)
+{
+	// same as loadItem for new items, but without touching the game: stationary
+	// items on the tile, beds and anything unreadable are left to loadItem
+	uint16_t id;
+	if (!propStream.read<uint16_t>(id)) {
+		return nullptr;
+	}
+
+	const ItemType& iType = Item::items[id];
+	if (iType.isBed() || (onTile && !iType.moveable && !iType.forceSerialize)) {
+		return nullptr;
+	}
+
+	Item* item = Item::CreateItem(id);
+	if (!item) {
+		return nullptr;
+	}
+
+	if (!item->unserializeAttr(propStream)) {
+		delete item;
+		return nullptr;
+	}
+
+	Container* container = item->getContainer();
+	if (container && !parseContainer(propStream, container)) {
+		delete item;
+		return nullptr;
+	}
+	return item;
+}
+
+bool IOMapSerialize::parseContainer(PropStream& propStream, Container* container)
+{
+	while (container->serializationCount > 0) {
+		Item* item = parseItem(propStream, false);
+		if (!item) {
+			return false;
+		}
+
+		container->internalAddThing(item);
+		container->serializationCount--;
+	}
+
+	uint8_t endAttr;
+	return propStream.read<uint8_t>(endAttr) && endAttr == 0;
+}
+
 bool IOMapSerialize::loadContainer(PropStream& propStream, Container* container)
 {
 	while (container->serializationCount > 0) {
@@ -299,7 +423,53 @@ bool IOMapSerialize::loadHouseInfo()
 	return true;
 }
 
-bool IOMapSerialize::saveHouseInfo()
+void IOMapSerialize::snapshotHouses(HouseSaveSnapshot& snapshot)
+{
+	PropWriteStream stream;
+	for (const auto& it : g_game.map.houses.getHouses()) {
+		House* house = it.second;
+		snapshot.houses.push_back({house->getId(), house->getOwner(), house->getPaidUntil(), house->getPayRentWarnings(), house->getName(), house->getTownId(), house->getRent(), house->getTiles().size(), house->getBedCount()});
+
+		std::string listText;
+		if (house->getAccessList(GUEST_LIST, listText) && !listText.empty()) {
+			snapshot.lists.emplace_back(house->getId(), GUEST_LIST, std::move(listText));
+			listText.clear();
+		}
+
+		if (house->getAccessList(SUBOWNER_LIST, listText) && !listText.empty()) {
+			snapshot.lists.emplace_back(house->getId(), SUBOWNER_LIST, std::move(listText));
+			listText.clear();
+		}
+
+		for (Door* door : house->getDoors()) {
+			if (door->getAccessList(listText) && !listText.empty()) {
+				snapshot.lists.emplace_back(house->getId(), door->getDoorId(), std::move(listText));
+				listText.clear();
+			}
+		}
+
+		//save house items, unless none of them changed since the last save
+		if (!house->hasItemsChanged()) {
+			continue;
+		}
+
+		house->setItemsChanged(false);
+		snapshot.changedHouses.push_back(house->getId());
+
+		for (HouseTile* tile : house->getTiles()) {
+			saveTile(stream, tile);
+
+			size_t attributesSize;
+			const char* attributes = stream.getStream(attributesSize);
+			if (attributesSize > 0) {
+				snapshot.tiles.emplace_back(house->getId(), std::string(attributes, attributesSize));
+				stream.clear();
+			}
+		}
+	}
+}
+
+bool IOMapSerialize::saveHouseInfo(const HouseSaveSnapshot& snapshot)
 {
 	Database& db = Database::getInstance();
 
@@ -313,16 +483,15 @@ bool IOMapSerialize::saveHouseInfo()
 	}
 
 	std::ostringstream query;
-	for (const auto& it : g_game.map.houses.getHouses()) {
-		House* house = it.second;
-		query << "SELECT `id` FROM `houses` WHERE `id` = " << house->getId();
+	for (const HouseSaveSnapshot::Info& house : snapshot.houses) {
+		query << "SELECT `id` FROM `houses` WHERE `id` = " << house.id;
 		DBResult_ptr result = db.storeQuery(query.str());
 		if (result) {
 			query.str(std::string());
-			query << "UPDATE `houses` SET `owner` = " << house->getOwner() << ", `paid` = " << house->getPaidUntil() << ", `warnings` = " << house->getPayRentWarnings() << ", `name` = " << db.escapeString(house->getName()) << ", `town_id` = " << house->getTownId() << ", `rent` = " << house->getRent() << ", `size` = " << house->getTiles().size() << ", `beds` = " << house->getBedCount() << " WHERE `id` = " << house->getId();
+			query << "UPDATE `houses` SET `owner` = " << house.owner << ", `paid` = " << house.paidUntil << ", `warnings` = " << house.payRentWarnings << ", `name` = " << db.escapeString(house.name) << ", `town_id` = " << house.townId << ", `rent` = " << house.rent << ", `size` = " << house.size << ", `beds` = " << house.beds << " WHERE `id` = " << house.id;
 		} else {
 			query.str(std::string());
-			query << "INSERT INTO `houses` (`id`, `owner`, `paid`, `warnings`, `name`, `town_id`, `rent`, `size`, `beds`) VALUES (" << house->getId() << ',' << house->getOwner() << ',' << house->getPaidUntil() << ',' << house->getPayRentWarnings() << ',' << db.escapeString(house->getName()) << ',' << house->getTownId() << ',' << house->getRent() << ',' << house->getTiles().size() << ',' << house->getBedCount() << ')';
+			query << "INSERT INTO `houses` (`id`, `owner`, `paid`, `warnings`, `name`, `town_id`, `rent`, `size`, `beds`) VALUES (" << house.id << ',' << house.owner << ',' << house.paidUntil << ',' << house.payRentWarnings << ',' << db.escapeString(house.name) << ',' << house.townId << ',' << house.rent << ',' << house.size << ',' << house.beds << ')';
 		}
 
 		db.executeQuery(query.str());
@@ -331,37 +500,10 @@ bool IOMapSerialize::saveHouseInfo()
 
 	DBInsert stmt("INSERT INTO `house_lists` (`house_id` , `listid` , `list`) VALUES ");
 
-	for (const auto& it : g_game.map.houses.getHouses()) {
-		House* house = it.second;
-
-		std::string listText;
-		if (house->getAccessList(GUEST_LIST, listText) && !listText.empty()) {
-			query << house->getId() << ',' << GUEST_LIST << ',' << db.escapeString(listText);
-			if (!stmt.addRow(query)) {
-				return false;
-			}
-
-			listText.clear();
-		}
-
-		if (house->getAccessList(SUBOWNER_LIST, listText) && !listText.empty()) {
-			query << house->getId() << ',' << SUBOWNER_LIST << ',' << db.escapeString(listText);
-			if (!stmt.addRow(query)) {
-				return false;
-			}
-
-			listText.clear();
-		}
-
-		for (Door* door : house->getDoors()) {
-			if (door->getAccessList(listText) && !listText.empty()) {
-				query << house->getId() << ',' << door->getDoorId() << ',' << db.escapeString(listText);
-				if (!stmt.addRow(query)) {
-					return false;
-				}
-
-				listText.clear();
-			}
+	for (const auto& list : snapshot.lists) {
+		query << std::get<0>(list) << ',' << std::get<1>(list) << ',' << db.escapeString(std::get<2>(list));
+		if (!stmt.addRow(query)) {
+			return false;
 		}
 	}
 
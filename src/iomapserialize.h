@@ -22,17 +22,51 @@
 #define FS_IOMAPSERIALIZE_H_7E903658F34E44F9BE03A713B55A3D6D
 
 #include "database.h"
+#include "fileloader.h"
 #include "map.h"
 
+// copy of the house data that gets saved, so it can be written on any thread
+struct HouseSaveSnapshot {
+	struct Info {
+		uint32_t id;
+		uint32_t owner;
+		time_t paidUntil;
+		uint32_t payRentWarnings;
+		std::string name;
+		uint32_t townId;
+		uint32_t rent;
+		size_t size;
+		uint32_t beds;
+	};
+
+	std::vector<Info> houses;
+	std::vector<std::tuple<uint32_t, uint32_t, std::string>> lists; // house id, list id, text
+	std::vector<std::pair<uint32_t, std::string>> tiles; // house id, serialized tile
+	std::vector<uint32_t> changedHouses; // only these get their tiles rewritten
+};
+
 class IOMapSerialize
 {
 	public:
 		static void loadHouseItems(Map* map);
-		static bool saveHouseItems();
 		static bool loadHouseInfo();
-		static bool saveHouseInfo();
+		static void snapshotHouses(HouseSaveSnapshot& snapshot);
+		static bool saveHouseItems(const HouseSaveSnapshot& snapshot);
+		static bool saveHouseInfo(const HouseSaveSnapshot& snapshot);
 
 	private:
+		// items of one stored tile, built away from the loader thread
+		struct LoadedTile {
+			Position position;
+			std::vector<std::unique_ptr<Item>> items;
+			PropStream rest; // starts at the first item that has to be loaded on the loader thread
+			uint32_t restCount = 0;
+		};
+
+		static void parseTile(const std::string& data, std::vector<LoadedTile>& tiles);
+		static Item* parseItem(PropStream& propStream, bool onTile);
+		static bool parseContainer(PropStream& propStream, Container* container);
+
 		static void saveItem(PropWriteStream& stream, const Item* item);
 		static void saveTile(PropWriteStream& stream, const Tile* tile);
 
@@ -31,59 +31,135 @@
 extern ConfigManager g_config;
 extern Game g_game;
 
-MarketOfferList IOMarket::getActiveOffers(MarketAction_t action, uint16_t itemId)
+bool IOMarket::loadOffers()
 {
-	MarketOfferList offerList;
+	DBResult_ptr result = Database::getInstance().storeQuery("SELECT MAX(`id`) AS `id` FROM `market_offers`");
+	if (!result) {
+		return false;
+	}
 
-	std::ostringstream query;
-	query << "SELECT `id`, `amount`, `price`, `created`, `anonymous`, (SELECT `name` FROM `characters` WHERE `id` = `character_id`) AS `character_name` FROM `market_offers` WHERE `sale` = " << action << " AND `itemtype` = " << itemId;
+	nextOfferId = result->getNumber<uint32_t>("id") + 1;
 
-	DBResult_ptr result = Database::getInstance().storeQuery(query.str());
+	result = Database::getInstance().streamQuery("SELECT `o`.`id`, `o`.`sale`, `o`.`itemtype`, `o`.`amount`, `o`.`created`, `o`.`price`, `o`.`character_id`, `o`.`anonymous`, `c`.`name` FROM `market_offers` `o` LEFT JOIN `characters` `c` ON `c`.`id` = `o`.`character_id`");
 	if (!result) {
-		return offerList;
+		return true;
 	}
 
-	const int32_t marketOfferDuration = g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
-
+	const size_t idColumn = result->getColumn("id");
+	const size_t saleColumn = result->getColumn("sale");
+	const size_t itemTypeColumn = result->getColumn("itemtype");
+	const size_t amountColumn = result->getColumn("amount");
+	const size_t createdColumn = result->getColumn("created");
+	const size_t priceColumn = result->getColumn("price");
+	const size_t characterColumn = result->getColumn("character_id");
+	const size_t anonymousColumn = result->getColumn("anonymous");
+	const size_t nameColumn = result->getColumn("name");
 	do {
-		MarketOffer offer;
-		offer.amount = result->getNumber<uint16_t>("amount");
-		offer.price = result->getNumber<uint32_t>("price");
-		offer.timestamp = result->getNumber<uint32_t>("created") + marketOfferDuration;
-		offer.counter = result->getNumber<uint32_t>("id") & 0xFFFF;
-		if (result->getNumber<uint16_t>("anonymous") == 0) {
-			offer.playerName = result->getString("character_name");
+		MarketOfferEx offer;
+		offer.id = result->getNumber<uint32_t>(idColumn);
+		offer.type = result->getNumber<uint16_t>(saleColumn) == MARKETACTION_BUY ? MARKETACTION_BUY : MARKETACTION_SELL;
+		offer.itemId = result->getNumber<uint16_t>(itemTypeColumn);
+		offer.amount = result->getNumber<uint16_t>(amountColumn);
+		offer.timestamp = result->getNumber<uint32_t>(createdColumn);
+		offer.price = result->getNumber<uint32_t>(priceColumn);
+		offer.playerId = result->getNumber<uint32_t>(characterColumn);
+		offer.counter = offer.id & 0xFFFF;
+		if (result->getNumber<uint16_t>(anonymousColumn) == 0) {
+			offer.playerName = result->getString(nameColumn);
 		} else {
 			offer.playerName = "Anonymous";
 		}
-		offerList.push_back(offer);
+		addOffer(std::move(offer));
 	} while (result->next());
-	return offerList;
+	return true;
 }
 
-MarketOfferList IOMarket::getOwnOffers(MarketAction_t action, uint32_t playerId)
+void IOMarket::addOffer(MarketOfferEx&& offer)
+{
+	uint32_t offerId = offer.id;
+	itemOffers[offer.type][offer.itemId].insert(offerId);
+	playerOffers[offer.playerId].insert(offerId);
+	offersByCreation.emplace(offer.timestamp, offerId);
+	offers.emplace(offerId, std::move(offer));
+}
+
+void IOMarket::removeOffer(uint32_t offerId)
+{
+	auto it = offers.find(offerId);
+	if (it == offers.end()) {
+		return;
+	}
+
+	const MarketOfferEx& offer = it->second;
+
+	auto itemIt = itemOffers[offer.type].find(offer.itemId);
+	itemIt->second.erase(offerId);
+	if (itemIt->second.empty()) {
+		itemOffers[offer.type].erase(itemIt);
+	}
+
+	auto playerIt = playerOffers.find(offer.playerId);
+	playerIt->second.erase(offerId);
+	if (playerIt->second.empty()) {
+		playerOffers.erase(playerIt);
+	}
+
+	offersByCreation.erase(std::make_pair(offer.timestamp, offerId));
+	offers.erase(it);
+}
+
+MarketOfferList IOMarket::getActiveOffers(MarketAction_t action, uint16_t itemId)
 {
 	MarketOfferList offerList;
 
+	IOMarket& market = getInstance();
+	auto it = market.itemOffers[action].find(itemId);
+	if (it == market.itemOffers[action].end()) {
+		return offerList;
+	}
+
 	const int32_t marketOfferDuration = g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
 
-	std::ostringstream query;
-	query << "SELECT `id`, `amount`, `price`, `created`, `itemtype` FROM `market_offers` WHERE `character_id` = " << playerId << " AND `sale` = " << action;
+	for (uint32_t offerId : it->second) {
+		const MarketOfferEx& offerEx = market.offers.find(offerId)->second;
 
-	DBResult_ptr result = Database::getInstance().storeQuery(query.str());
-	if (!result) {
+		MarketOffer offer;
+		offer.amount = offerEx.amount;
+		offer.price = offerEx.price;
+		offer.timestamp = offerEx.timestamp + marketOfferDuration;
+		offer.counter = offerEx.counter;
+		offer.playerName = offerEx.playerName;
+		offerList.push_back(offer);
+	}
+	return offerList;
+}
+
+MarketOfferList IOMarket::getOwnOffers(MarketAction_t action, uint32_t playerId)
+{
+	MarketOfferList offerList;
+
+	IOMarket& market = getInstance();
+	auto it = market.playerOffers.find(playerId);
+	if (it == market.playerOffers.end()) {
 		return offerList;
 	}
 
-	do {
+	const int32_t marketOfferDuration = g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
+
+	for (uint32_t offerId : it->second) {
+		const MarketOfferEx& offerEx = market.offers.find(offerId)->second;
+		if (offerEx.type != action) {
+			continue;
+		}
+
 		MarketOffer offer;
-		offer.amount = result->getNumber<uint16_t>("amount");
-		offer.price = result->getNumber<uint32_t>("price");
-		offer.timestamp = result->getNumber<uint32_t>("created") + marketOfferDuration;
-		offer.counter = result->getNumber<uint32_t>("id") & 0xFFFF;
-		offer.itemId = result->getNumber<uint16_t>("itemtype");
+		offer.amount = offerEx.amount;
+		offer.price = offerEx.price;
+		offer.timestamp = offerEx.timestamp + marketOfferDuration;
+		offer.counter = offerEx.counter;
+		offer.itemId = offerEx.itemId;
 		offerList.push_back(offer);
-	} while (result->next());
+	}
 	return offerList;
 }
 
@@ -99,14 +175,19 @@ HistoryMarketOfferList IOMarket::getOwnHistory(MarketAction_t action, uint32_t p
 		return offerList;
 	}
 
+	const size_t itemTypeColumn = result->getColumn("itemtype");
+	const size_t amountColumn = result->getColumn("amount");
+	const size_t priceColumn = result->getColumn("price");
+	const size_t expiresColumn = result->getColumn("expires_at");
+	const size_t stateColumn = result->getColumn("state");
 	do {
 		HistoryMarketOffer offer;
-		offer.itemId = result->getNumber<uint16_t>("itemtype");
-		offer.amount = result->getNumber<uint16_t>("amount");
-		offer.price = result->getNumber<uint32_t>("price");
-		offer.timestamp = result->getNumber<uint32_t>("expires_at");
+		offer.itemId = result->getNumber<uint16_t>(itemTypeColumn);
+		offer.amount = result->getNumber<uint16_t>(amountColumn);
+		offer.price = result->getNumber<uint32_t>(priceColumn);
+		offer.timestamp = result->getNumber<uint32_t>(expiresColumn);
 
-		MarketOfferState_t offerState = static_cast<MarketOfferState_t>(result->getNumber<uint16_t>("state"));
+		MarketOfferState_t offerState = static_cast<MarketOfferState_t>(result->getNumber<uint16_t>(stateColumn));
 		if (offerState == OFFERSTATE_ACCEPTEDEX) {
 			offerState = OFFERSTATE_ACCEPTED;
 		}
@@ -118,87 +199,103 @@ HistoryMarketOfferList IOMarket::getOwnHistory(MarketAction_t action, uint32_t p
 	return offerList;
 }
 
-void IOMarket::processExpiredOffers(DBResult_ptr result, bool)
+void IOMarket::expireOffer(uint32_t offerId)
 {
-	if (!result) {
+	//dispatcher thread
+	IOMarket& market = getInstance();
+	auto it = market.offers.find(offerId);
+	if (it == market.offers.end()) {
 		return;
 	}
 
-	do {
-		if (!IOMarket::moveOfferToHistory(result->getNumber<uint32_t>("id"), OFFERSTATE_EXPIRED)) {
-			continue;
+	// the owner's login would overwrite what gets returned to them, it waits for it
+	if (IOLoginData::deferWhileLoading(it->second.playerId, [offerId]() { expireOffer(offerId); })) {
+		return;
+	}
+
+	processExpiredOffer(it->second);
+	moveOfferToHistory(offerId, OFFERSTATE_EXPIRED);
+}
+
+void IOMarket::processExpiredOffer(const MarketOfferEx& offer)
+{
+	if (offer.type == MARKETACTION_SELL) {
+		const ItemType& itemType = Item::items[offer.itemId];
+		if (itemType.id == 0) {
+			return;
 		}
 
-		const uint32_t playerId = result->getNumber<uint32_t>("character_id");
-		const uint16_t amount = result->getNumber<uint16_t>("amount");
-		if (result->getNumber<uint16_t>("sale") == 1) {
-			const ItemType& itemType = Item::items[result->getNumber<uint16_t>("itemtype")];
-			if (itemType.id == 0) {
-				continue;
+		Player* player = g_game.getPlayerByGUID(offer.playerId);
+		if (!player) {
+			player = new Player(nullptr);
+			if (!IOLoginData::loadPlayerById(player, offer.playerId)) {
+				delete player;
+				return;
 			}
+		}
 
-			Player* player = g_game.getPlayerByGUID(playerId);
-			if (!player) {
-				player = new Player(nullptr);
-				if (!IOLoginData::loadPlayerById(player, playerId)) {
-					delete player;
-					continue;
+		if (itemType.stackable) {
+			uint16_t tmpAmount = offer.amount;
+			while (tmpAmount > 0) {
+				uint16_t stackCount = std::min<uint16_t>(itemType.getItemMaxCount(), tmpAmount);
+				Item* item = Item::CreateItem(itemType.id, stackCount);
+				if (g_game.internalAddItem(player->getInbox(), item, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
+					delete item;
+					break;
 				}
-			}
 
-			if (itemType.stackable) {
-				uint16_t tmpAmount = amount;
-				while (tmpAmount > 0) {
-					uint16_t stackCount = std::min<uint16_t>(itemType.getItemMaxCount(), tmpAmount);
-					Item* item = Item::CreateItem(itemType.id, stackCount);
-					if (g_game.internalAddItem(player->getInbox(), item, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
-						delete item;
-						break;
-					}
-
-					tmpAmount -= stackCount;
-				}
+				tmpAmount -= stackCount;
+			}
+		} else {
+			int32_t subType;
+			if (itemType.charges != 0) {
+				subType = itemType.charges;
 			} else {
-				int32_t subType;
-				if (itemType.charges != 0) {
-					subType = itemType.charges;
-				} else {
-					subType = -1;
-				}
+				subType = -1;
+			}
 
-				for (uint16_t i = 0; i < amount; ++i) {
-					Item* item = Item::CreateItem(itemType.id, subType);
-					if (g_game.internalAddItem(player->getInbox(), item, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
-						delete item;
-						break;
-					}
+			for (uint16_t i = 0; i < offer.amount; ++i) {
+				Item* item = Item::CreateItem(itemType.id, subType);
+				if (g_game.internalAddItem(player->getInbox(), item, INDEX_WHEREEVER, FLAG_NOLIMIT) != RETURNVALUE_NOERROR) {
+					delete item;
+					break;
 				}
 			}
+		}
 
-			if (player->isOffline()) {
-				IOLoginData::savePlayer(player);
-				delete player;
-			}
-		} else {
-			uint64_t totalPrice = result->getNumber<uint64_t>("price") * amount;
+		if (player->isOffline()) {
+			IOLoginData::savePlayer(player);
+			delete player;
+		}
+	} else {
+		uint64_t totalPrice = static_cast<uint64_t>(offer.price) * offer.amount;
 
-			Player* player = g_game.getPlayerByGUID(playerId);
-			if (player) {
-				player->setBankBalance(player->getBankBalance() + totalPrice);
-			} else {
-				IOLoginData::increaseBankBalance(playerId, totalPrice);
-			}
+		Player* player = g_game.getPlayerByGUID(offer.playerId);
+		if (player) {
+			player->setBankBalance(player->getBankBalance() + totalPrice);
+		} else {
+			IOLoginData::increaseBankBalance(offer.playerId, totalPrice);
 		}
-	} while (result->next());
+	}
 }
 
 void IOMarket::checkExpiredOffers()
 {
+	//dispatcher thread
 	const time_t lastExpireDate = time(nullptr) - g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
 
-	std::ostringstream query;
-	query << "SELECT `id`, `amount`, `price`, `itemtype`, `character_id`, `sale` FROM `market_offers` WHERE `created` <= " << lastExpireDate;
-	g_databaseTasks.addTask(query.str(), IOMarket::processExpiredOffers, true);
+	// the oldest offers come first, stop at the first one that is still running
+	std::vector<uint32_t> expiredOffers;
+	for (const auto& it : getInstance().offersByCreation) {
+		if (it.first > lastExpireDate) {
+			break;
+		}
+		expiredOffers.push_back(it.second);
+	}
+
+	for (uint32_t offerId : expiredOffers) {
+		expireOffer(offerId);
+	}
 
 	int32_t checkExpiredMarketOffersEachMinutes = g_config.getNumber(ConfigManager::CHECK_EXPIRED_MARKET_OFFERS_EACH_MINUTES);
 	if (checkExpiredMarketOffersEachMinutes <= 0) {
@@ -210,66 +307,85 @@ void IOMarket::checkExpiredOffers()
 
 uint32_t IOMarket::getPlayerOfferCount(uint32_t playerId)
 {
-	std::ostringstream query;
-	query << "SELECT COUNT(*) AS `count` FROM `market_offers` WHERE `character_id` = " << playerId;
-
-	DBResult_ptr result = Database::getInstance().storeQuery(query.str());
-	if (!result) {
+	IOMarket& market = getInstance();
+	auto it = market.playerOffers.find(playerId);
+	if (it == market.playerOffers.end()) {
 		return 0;
 	}
-	return result->getNumber<int32_t>("count");
+	return it->second.size();
 }
 
 MarketOfferEx IOMarket::getOfferByCounter(uint32_t timestamp, uint16_t counter)
 {
 	MarketOfferEx offer;
 
-	const int32_t created = timestamp - g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
-
-	std::ostringstream query;
-	query << "SELECT `id`, `sale`, `itemtype`, `amount`, `created`, `price`, `character_id`, `anonymous`, (SELECT `name` FROM `characters` WHERE `id` = `character_id`) AS `character_name` FROM `market_offers` WHERE `created` = " << created << " AND (`id` & 65535) = " << counter << " LIMIT 1";
-
-	DBResult_ptr result = Database::getInstance().storeQuery(query.str());
-	if (!result) {
-		offer.id = 0;
-		return offer;
+	const uint32_t created = timestamp - g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
+
+	IOMarket& market = getInstance();
+	for (auto it = market.offersByCreation.lower_bound(std::make_pair(created, 0)); it != market.offersByCreation.end() && it->first == created; ++it) {
+		if ((it->second & 0xFFFF) == counter) {
+			const MarketOfferEx& found = market.offers.find(it->second)->second;
+			offer.id = found.id;
+			offer.playerId = found.playerId;
+			offer.timestamp = found.timestamp;
+			offer.price = found.price;
+			offer.amount = found.amount;
+			offer.counter = found.counter;
+			offer.itemId = found.itemId;
+			offer.type = found.type;
+			offer.playerName = found.playerName;
+			return offer;
+		}
 	}
 
-	offer.id = result->getNumber<uint32_t>("id");
-	offer.type = static_cast<MarketAction_t>(result->getNumber<uint16_t>("sale"));
-	offer.amount = result->getNumber<uint16_t>("amount");
-	offer.counter = result->getNumber<uint32_t>("id") & 0xFFFF;
-	offer.timestamp = result->getNumber<uint32_t>("created");
-	offer.price = result->getNumber<uint32_t>("price");
-	offer.itemId = result->getNumber<uint16_t>("itemtype");
-	offer.playerId = result->getNumber<uint32_t>("character_id");
-	if (result->getNumber<uint16_t>("anonymous") == 0) {
-		offer.playerName = result->getString("character_name");
-	} else {
-		offer.playerName = "Anonymous";
-	}
+	offer.id = 0;
 	return offer;
 }
 
-void IOMarket::createOffer(uint32_t playerId, MarketAction_t action, uint32_t itemId, uint16_t amount, uint32_t price, bool anonymous)
+void IOMarket::createOffer(uint32_t playerId, const std::string& playerName, MarketAction_t action, uint32_t itemId, uint16_t amount, uint32_t price, bool anonymous)
 {
+	IOMarket& market = getInstance();
+
+	MarketOfferEx offer;
+	offer.id = market.nextOfferId++;
+	offer.playerId = playerId;
+	offer.timestamp = time(nullptr);
+	offer.price = price;
+	offer.amount = amount;
+	offer.counter = offer.id & 0xFFFF;
+	offer.itemId = itemId;
+	offer.type = action;
+	offer.playerName = anonymous ? "Anonymous" : playerName;
+
 	std::ostringstream query;
-	query << "INSERT INTO `market_offers` (`character_id`, `sale`, `itemtype`, `amount`, `price`, `created`, `anonymous`) VALUES (" << playerId << ',' << action << ',' << itemId << ',' << amount << ',' << price << ',' << time(nullptr) << ',' << anonymous << ')';
-	Database::getInstance().executeQuery(query.str());
+	query << "INSERT INTO `market_offers` (`id`, `character_id`, `sale`, `itemtype`, `amount`, `price`, `created`, `anonymous`) VALUES (" << offer.id << ',' << playerId << ',' << action << ',' << itemId << ',' << amount << ',' << price << ',' << offer.timestamp << ',' << anonymous << ')';
+	g_databaseTasks.addTask(query.str(), nullptr, false, DATABASE_ORDER_MARKET);
+
+	market.addOffer(std::move(offer));
 }
 
 void IOMarket::acceptOffer(uint32_t offerId, uint16_t amount)
 {
+	IOMarket& market = getInstance();
+	auto it = market.offers.find(offerId);
+	if (it == market.offers.end()) {
+		return;
+	}
+
+	it->second.amount -= amount;
+
 	std::ostringstream query;
 	query << "UPDATE `market_offers` SET `amount` = `amount` - " << amount << " WHERE `id` = " << offerId;
-	Database::getInstance().executeQuery(query.str());
+	g_databaseTasks.addTask(query.str(), nullptr, false, DATABASE_ORDER_MARKET);
 }
 
 void IOMarket::deleteOffer(uint32_t offerId)
 {
+	getInstance().removeOffer(offerId);
+
 	std::ostringstream query;
 	query << "DELETE FROM `market_offers` WHERE `id` = " << offerId;
-	Database::getInstance().executeQuery(query.str());
+	g_databaseTasks.addTask(query.str(), nullptr, false, DATABASE_ORDER_MARKET);
 }
 
 void IOMarket::appendHistory(uint32_t playerId, MarketAction_t type, uint16_t itemId, uint16_t amount, uint32_t price, time_t timestamp, MarketOfferState_t state)
@@ -278,30 +394,25 @@ void IOMarket::appendHistory(uint32_t playerId, MarketAction_t type, uint16_t it
 	query << "INSERT INTO `market_history` (`character_id`, `sale`, `itemtype`, `amount`, `price`, `expires_at`, `inserted`, `state`) VALUES ("
 		<< playerId << ',' << type << ',' << itemId << ',' << amount << ',' << price << ','
 		<< timestamp << ',' << time(nullptr) << ',' << state << ')';
-	g_databaseTasks.addTask(query.str());
+	g_databaseTasks.addTask(query.str(), nullptr, false, DATABASE_ORDER_MARKET);
+
+	if (state == OFFERSTATE_ACCEPTED) {
+		getInstance().addStatistics(type, itemId, price);
+	}
 }
 
 bool IOMarket::moveOfferToHistory(uint32_t offerId, MarketOfferState_t state)
 {
-	const int32_t marketOfferDuration = g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
-
-	Database& db = Database::getInstance();
-
-	std::ostringstream query;
-	query << "SELECT `character_id`, `sale`, `itemtype`, `amount`, `price`, `created` FROM `market_offers` WHERE `id` = " << offerId;
-
-	DBResult_ptr result = db.storeQuery(query.str());
-	if (!result) {
-		return false;
-	}
-
-	query.str(std::string());
-	query << "DELETE FROM `market_offers` WHERE `id` = " << offerId;
-	if (!db.executeQuery(query.str())) {
+	IOMarket& market = getInstance();
+	auto it = market.offers.find(offerId);
+	if (it == market.offers.end()) {
 		return false;
 	}
 
-	appendHistory(result->getNumber<uint32_t>("character_id"), static_cast<MarketAction_t>(result->getNumber<uint16_t>("sale")), result->getNumber<uint16_t>("itemtype"), result->getNumber<uint16_t>("amount"), result->getNumber<uint32_t>("price"), result->getNumber<uint32_t>("created") + marketOfferDuration, state);
+	const MarketOfferEx& offer = it->second;
+	const int32_t marketOfferDuration = g_config.getNumber(ConfigManager::MARKET_OFFER_DURATION);
+	appendHistory(offer.playerId, offer.type, offer.itemId, offer.amount, offer.price, offer.timestamp + marketOfferDuration, state);
+	deleteOffer(offerId);
 	return true;
 }
 
@@ -309,26 +420,48 @@ void IOMarket::updateStatistics()
 {
 	std::ostringstream query;
 	query << "SELECT `sale` AS `sale`, `itemtype` AS `itemtype`, COUNT(`price`) AS `num`, MIN(`price`) AS `min`, MAX(`price`) AS `max`, SUM(`price`) AS `sum` FROM `market_history` WHERE `state` = " << OFFERSTATE_ACCEPTED << " GROUP BY `itemtype`, `sale`";
-	DBResult_ptr result = Database::getInstance().storeQuery(query.str());
+	DBResult_ptr result = Database::getInstance().streamQuery(query.str());
 	if (!result) {
 		return;
 	}
 
+	const size_t saleColumn = result->getColumn("sale");
+	const size_t itemTypeColumn = result->getColumn("itemtype");
+	const size_t numColumn = result->getColumn("num");
+	const size_t minColumn = result->getColumn("min");
+	const size_t maxColumn = result->getColumn("max");
+	const size_t sumColumn = result->getColumn("sum");
 	do {
 		MarketStatistics* statistics;
-		if (result->getNumber<uint16_t>("sale") == MARKETACTION_BUY) {
-			statistics = &purchaseStatistics[result->getNumber<uint16_t>("itemtype")];
+		if (result->getNumber<uint16_t>(saleColumn) == MARKETACTION_BUY) {
+			statistics = &purchaseStatistics[result->getNumber<uint16_t>(itemTypeColumn)];
 		} else {
-			statistics = &saleStatistics[result->getNumber<uint16_t>("itemtype")];
+			statistics = &saleStatistics[result->getNumber<uint16_t>(itemTypeColumn)];
 		}
 
-		statistics->numTransactions = result->getNumber<uint32_t>("num");
-		statistics->lowestPrice = result->getNumber<uint32_t>("min");
-		statistics->totalPrice = result->getNumber<uint64_t>("sum");
-		statistics->highestPrice = result->getNumber<uint32_t>("max");
+		statistics->numTransactions = result->getNumber<uint32_t>(numColumn);
+		statistics->lowestPrice = result->getNumber<uint32_t>(minColumn);
+		statistics->totalPrice = result->getNumber<uint64_t>(sumColumn);
+		statistics->highestPrice = result->getNumber<uint32_t>(maxColumn);
 	} while (result->next());
 }
 
+void IOMarket::addStatistics(MarketAction_t type, uint16_t itemId, uint32_t price)
+{
+	// same aggregate as updateStatistics, one accepted history row at a time
+	MarketStatistics& statistics = (type == MARKETACTION_BUY ? purchaseStatistics[itemId] : saleStatistics[itemId]);
+	if (statistics.numTransactions == 0) {
+		statistics.lowestPrice = price;
+		statistics.highestPrice = price;
+	} else {
+		statistics.lowestPrice = std::min(statistics.lowestPrice, price);
+		statistics.highestPrice = std::max(statistics.highestPrice, price);
+	}
+
+	++statistics.numTransactions;
+	statistics.totalPrice += price;
+}
+
 MarketStatistics* IOMarket::getPurchaseStatistics(uint16_t itemId)
 {
 	auto it = purchaseStatistics.find(itemId);
@@ -21,6 +21,8 @@
 #ifndef FS_IOMARKET_H_B981E52C218C42D3B9EF726EBF0E92C9
 #define FS_IOMARKET_H_B981E52C218C42D3B9EF726EBF0E92C9
 
+#include <set>
+
 #include "enums.h"
 #include "database.h"
 
@@ -32,17 +34,19 @@ class IOMarket
 			return instance;
 		}
 
+		// the offers live in memory, the table only gets written behind
+		bool loadOffers();
+
 		static MarketOfferList getActiveOffers(MarketAction_t action, uint16_t itemId);
 		static MarketOfferList getOwnOffers(MarketAction_t action, uint32_t playerId);
 		static HistoryMarketOfferList getOwnHistory(MarketAction_t action, uint32_t playerId);
 
-		static void processExpiredOffers(DBResult_ptr result, bool);
 		static void checkExpiredOffers();
 
 		static uint32_t getPlayerOfferCount(uint32_t playerId);
 		static MarketOfferEx getOfferByCounter(uint32_t timestamp, uint16_t counter);
 
-		static void createOffer(uint32_t playerId, MarketAction_t action, uint32_t itemId, uint16_t amount, uint32_t price, bool anonymous);
+		static void createOffer(uint32_t playerId, const std::string& playerName, MarketAction_t action, uint32_t itemId, uint16_t amount, uint32_t price, bool anonymous);
 		static void acceptOffer(uint32_t offerId, uint16_t amount);
 		static void deleteOffer(uint32_t offerId);
 
@@ -50,6 +54,7 @@ class IOMarket
 		static bool moveOfferToHistory(uint32_t offerId, MarketOfferState_t state);
 
 		void updateStatistics();
+		void addStatistics(MarketAction_t type, uint16_t itemId, uint32_t price);
 
 		MarketStatistics* getPurchaseStatistics(uint16_t itemId);
 		MarketStatistics* getSaleStatistics(uint16_t itemId);
@@ -57,8 +62,20 @@ class IOMarket
 	private:
 		IOMarket() = default;
 
+		void addOffer(MarketOfferEx&& offer);
+		void removeOffer(uint32_t offerId);
+		static void expireOffer(uint32_t offerId);
+		static void processExpiredOffer(const MarketOfferEx& offer);
+
 		std::map<uint16_t, MarketStatistics> purchaseStatistics;
 		std::map<uint16_t, MarketStatistics> saleStatistics;
+
+		//dispatcher thread
+		std::map<uint32_t, MarketOfferEx> offers;
+		std::map<uint16_t, std::set<uint32_t>> itemOffers[MARKETACTION_SELL + 1];
+		std::map<uint32_t, std::set<uint32_t>> playerOffers;
+		std::set<std::pair<uint32_t, uint32_t>> offersByCreation; // created, offer id
+		uint32_t nextOfferId = 1;
 };
 
 #endif
@@ -0,0 +1,421 @@
+/**
+ * The Ruby Server - a free and open-source Pokémon MMORPG server emulator
+ * Copyright (C) 2018  Mark Samman (TFS) <mark.samman@gmail.com>
+ *                     Leandro Matheus <kesuhige@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "otpch.h"
+
+#include "journal.h"
+#include "tools.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <fstream>
+
+namespace {
+
+// past this size the file gets rewritten with only the records still needed
+constexpr size_t JOURNAL_COMPACT_SIZE = 16 * 1024 * 1024;
+
+template <typename T>
+void put(std::string& buffer, T value)
+{
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void putString(std::string& buffer, const std::string& value)
+{
+	put<uint32_t>(buffer, value.length());
+	buffer.append(value);
+}
+
+class RecordReader
+{
+	public:
+		RecordReader(const char* data, size_t length) : p(data), end(data + length) {}
+
+		size_t size() const {
+			return end - p;
+		}
+
+		template <typename T>
+		bool get(T& ret) {
+			if (size() < sizeof(T)) {
+				return false;
+			}
+
+			memcpy(&ret, p, sizeof(T));
+			p += sizeof(T);
+			return true;
+		}
+
+		bool getBytes(std::string& ret, size_t length) {
+			if (size() < length) {
+				return false;
+			}
+
+			ret.assign(p, length);
+			p += length;
+			return true;
+		}
+
+		bool getString(std::string& ret) {
+			uint32_t length;
+			return get(length) && getBytes(ret, length);
+		}
+
+	private:
+		const char* p;
+		const char* end;
+};
+
+std::string recordHeader(JournalRecord_t type, uint32_t guid, uint64_t sequence)
+{
+	std::string record;
+	put<uint8_t>(record, type);
+	put(record, guid);
+	put(record, sequence);
+	return record;
+}
+
+std::string progressRecord(uint32_t guid, uint64_t sequence, uint32_t level, uint64_t experience)
+{
+	std::string record = recordHeader(JOURNAL_PLAYER_PROGRESS, guid, sequence);
+	put(record, level);
+	put(record, experience);
+	return record;
+}
+
+std::string itemsRecord(uint32_t guid, uint64_t sequence, uint8_t section, const std::vector<std::string>& rows)
+{
+	std::string record = recordHeader(JOURNAL_PLAYER_ITEMS, guid, sequence);
+	put(record, section);
+	put<uint32_t>(record, rows.size());
+	for (const std::string& row : rows) {
+		putString(record, row);
+	}
+	return record;
+}
+
+// length and checksum first, so a record torn by a crash is recognized
+void frameRecord(std::string& buffer, const std::string& record)
+{
+	put<uint32_t>(buffer, record.length());
+	put<uint32_t>(buffer, adlerChecksum(reinterpret_cast<const uint8_t*>(record.data()), record.length()));
+	buffer.append(record);
+}
+
+bool applyRecord(std::map<uint32_t, JournalEntry>& entries, const std::string& record)
+{
+	RecordReader reader(record.data(), record.length());
+
+	uint8_t type;
+	uint32_t guid;
+	uint64_t sequence;
+	if (!reader.get(type) || !reader.get(guid) || !reader.get(sequence)) {
+		return false;
+	}
+
+	switch (type) {
+		case JOURNAL_PLAYER_PROGRESS: {
+			uint32_t level;
+			uint64_t experience;
+			if (!reader.get(level) || !reader.get(experience)) {
+				return false;
+			}
+
+			JournalEntry& entry = entries[guid];
+			if (entry.sequences[SAVESECTION_STATS] < sequence) {
+				entry.sequences[SAVESECTION_STATS] = sequence;
+				entry.level = level;
+				entry.experience = experience;
+			}
+			return true;
+		}
+
+		case JOURNAL_PLAYER_ITEMS: {
+			uint8_t section;
+			uint32_t count;
+			if (!reader.get(section) || section <= SAVESECTION_STATS || section > SAVESECTION_LAST || !reader.get(count)) {
+				return false;
+			}
+
+			std::vector<std::string> rows;
+			for (uint32_t i = 0; i < count; ++i) {
+				std::string row;
+				if (!reader.getString(row)) {
+					return false;
+				}
+				rows.push_back(std::move(row));
+			}
+
+			JournalEntry& entry = entries[guid];
+			if (entry.sequences[section] < sequence) {
+				entry.sequences[section] = sequence;
+				entry.rows[section] = std::move(rows);
+			}
+			return true;
+		}
+
+		case JOURNAL_PLAYER_SAVED: {
+			// the save holds everything journaled before it was taken
+			auto it = entries.find(guid);
+			if (it == entries.end()) {
+				return true;
+			}
+
+			JournalEntry& entry = it->second;
+			for (uint8_t section = SAVESECTION_FIRST; section <= SAVESECTION_LAST; ++section) {
+				if (entry.sequences[section] < sequence) {
+					entry.sequences[section] = 0;
+					entry.rows[section].clear();
+				}
+			}
+
+			if (entry.empty()) {
+				entries.erase(it);
+			}
+			return true;
+		}
+
+		default:
+			return false;
+	}
+}
+
+bool flushFile(FILE* file)
+{
+	if (fflush(file) != 0) {
+		return false;
+	}
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+}
+
+bool JournalEntry::empty() const
+{
+	for (uint64_t sequence : sequences) {
+		if (sequence != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+Journal::~Journal()
+{
+	if (file) {
+		fclose(file);
+	}
+}
+
+bool Journal::load(const std::string& filename)
+{
+	this->filename = filename;
+	if (filename.empty()) {
+		return true;
+	}
+
+	std::ifstream input(filename, std::ios::binary);
+	if (!input.is_open()) {
+		// nothing was journaled yet
+		return true;
+	}
+
+	std::string data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+	if (input.bad()) {
+		std::cout << "[Error - Journal::load] Unable to read " << filename << std::endl;
+		return false;
+	}
+
+	RecordReader reader(data.data(), data.length());
+	while (reader.size() != 0) {
+		// a crash can only tear the last record, everything before it is intact
+		RecordReader next = reader;
+		uint32_t length, checksum;
+		std::string record;
+		if (!next.get(length) || !next.get(checksum) || !next.getBytes(record, length) ||
+		        adlerChecksum(reinterpret_cast<const uint8_t*>(record.data()), length) != checksum || !applyRecord(entries, record)) {
+			break;
+		}
+		reader = next;
+	}
+
+	if (reader.size() != 0) {
+		std::cout << "[Warning - Journal::load] Ignoring the last " << reader.size() << " bytes of " << filename << ", they were not written completely." << std::endl;
+	}
+	return true;
+}
+
+bool Journal::start()
+{
+	entries.clear();
+	if (filename.empty()) {
+		return true;
+	}
+
+	// the truncation has to reach the disk, or the replayed records could be replayed again
+	file = fopen(filename.c_str(), "wb");
+	if (!file || !flushFile(file)) {
+		std::cout << "[Error - Journal::start] Unable to create " << filename << std::endl;
+		return false;
+	}
+
+	fileSize = 0;
+	compactSize = JOURNAL_COMPACT_SIZE;
+	started = true;
+	return true;
+}
+
+void Journal::close()
+{
+	if (!started) {
+		return;
+	}
+
+	sync();
+	started = false;
+
+	std::lock_guard<std::mutex> fileGuard(fileLock);
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+}
+
+void Journal::addProgress(uint32_t guid, uint64_t sequence, uint32_t level, uint64_t experience)
+{
+	add(progressRecord(guid, sequence, level, experience));
+}
+
+void Journal::addItems(uint32_t guid, uint64_t sequence, savesection_t section, std::vector<std::string> rows)
+{
+	add(itemsRecord(guid, sequence, section, rows));
+}
+
+void Journal::addSaved(uint32_t guid, uint64_t sequence)
+{
+	add(recordHeader(JOURNAL_PLAYER_SAVED, guid, sequence));
+}
+
+void Journal::add(const std::string& record)
+{
+	if (!started) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> pendingGuard(pendingLock);
+	applyRecord(entries, record);
+	frameRecord(pending, record);
+}
+
+bool Journal::sync()
+{
+	std::lock_guard<std::mutex> fileGuard(fileLock);
+
+	std::string buffer;
+	bool compact;
+	{
+		std::lock_guard<std::mutex> pendingGuard(pendingLock);
+		if (pending.empty()) {
+			return true;
+		}
+
+		compact = !file || fileSize + pending.size() >= compactSize;
+		if (compact) {
+			// the entries already hold everything pending
+			for (const auto& it : entries) {
+				const JournalEntry& entry = it.second;
+				if (entry.sequences[SAVESECTION_STATS] != 0) {
+					frameRecord(buffer, progressRecord(it.first, entry.sequences[SAVESECTION_STATS], entry.level, entry.experience));
+				}
+
+				for (uint8_t section = SAVESECTION_INVENTORY; section <= SAVESECTION_LAST; ++section) {
+					if (entry.sequences[section] != 0) {
+						frameRecord(buffer, itemsRecord(it.first, entry.sequences[section], section, entry.rows[section]));
+					}
+				}
+			}
+			pending.clear();
+		} else {
+			buffer.swap(pending);
+		}
+	}
+
+	if (compact) {
+		if (!rewrite(buffer)) {
+			std::cout << "[Error - Journal::sync] Unable to rewrite " << filename << std::endl;
+			return false;
+		}
+
+		compactSize = std::max(JOURNAL_COMPACT_SIZE, buffer.size() * 2);
+		return true;
+	}
+
+	if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size() || !flushFile(file)) {
+		std::cout << "[Error - Journal::sync] Unable to write " << filename << std::endl;
+		// the tail may be torn now, start over from the entries next time
+		fileSize = compactSize;
+		return false;
+	}
+
+	fileSize += buffer.size();
+	return true;
+}
+
+bool Journal::rewrite(const std::string& buffer)
+{
+	const std::string tmpFilename = filename + ".tmp";
+	FILE* tmpFile = fopen(tmpFilename.c_str(), "wb");
+	if (!tmpFile) {
+		return false;
+	}
+
+	bool written = fwrite(buffer.data(), 1, buffer.size(), tmpFile) == buffer.size() && flushFile(tmpFile);
+	fclose(tmpFile);
+	if (!written) {
+		std::remove(tmpFilename.c_str());
+		return false;
+	}
+
+	if (file) {
+		fclose(file);
+		file = nullptr;
+	}
+
+#ifdef _WIN32
+	// rename does not replace existing files here
+	std::remove(filename.c_str());
+#endif
+	if (std::rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+		return false;
+	}
+
+	file = fopen(filename.c_str(), "ab");
+	fileSize = buffer.size();
+	return file != nullptr;
+}
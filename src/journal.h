@@ -0,0 +1,101 @@
+/**
+ * The Ruby Server - a free and open-source Pokémon MMORPG server emulator
+ * Copyright (C) 2018  Mark Samman (TFS) <mark.samman@gmail.com>
+ *                     Leandro Matheus <kesuhige@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FS_JOURNAL_H_5D2E8A41C7B94F0E9A3B6C1D8E7F2A90
+#define FS_JOURNAL_H_5D2E8A41C7B94F0E9A3B6C1D8E7F2A90
+
+#include "player.h"
+
+enum JournalRecord_t : uint8_t {
+	JOURNAL_PLAYER_PROGRESS = 1,
+	JOURNAL_PLAYER_ITEMS = 2,
+	JOURNAL_PLAYER_SAVED = 3,
+};
+
+/**
+ * What the journal knows about a player that the database may not have
+ * yet; the stats section holds only the level and experience.
+ */
+struct JournalEntry {
+	std::vector<std::string> rows[SAVESECTION_LAST + 1];
+	uint64_t sequences[SAVESECTION_LAST + 1] = {}; // 0 for sections it knows nothing about
+	uint64_t experience = 0;
+	uint32_t level = 0;
+
+	bool empty() const;
+};
+
+/**
+ * Append-only file of the player changes made since their last save, so a
+ * crash loses seconds instead of everything since the last save. Records
+ * are absolute values, replaying one only needs the newest of each kind.
+ */
+class Journal
+{
+	public:
+		Journal() = default;
+		~Journal();
+
+		// non-copyable
+		Journal(const Journal&) = delete;
+		Journal& operator=(const Journal&) = delete;
+
+		// reads what the previous run left behind, an empty filename disables the journal
+		bool load(const std::string& filename);
+
+		// drops what was loaded and starts a new file, once that got replayed
+		bool start();
+		void close();
+
+		bool isStarted() const {
+			return started;
+		}
+
+		//any thread
+		void addProgress(uint32_t guid, uint64_t sequence, uint32_t level, uint64_t experience);
+		void addItems(uint32_t guid, uint64_t sequence, savesection_t section, std::vector<std::string> rows);
+		void addSaved(uint32_t guid, uint64_t sequence);
+
+		// writes everything added so far and returns once it is on disk
+		bool sync();
+
+		// between load and start only
+		const std::map<uint32_t, JournalEntry>& getEntries() const {
+			return entries;
+		}
+
+	private:
+		void add(const std::string& record);
+		bool rewrite(const std::string& buffer);
+
+		std::map<uint32_t, JournalEntry> entries;
+		std::string pending;
+		std::string filename;
+		std::mutex pendingLock;
+		std::mutex fileLock;
+		FILE* file = nullptr;
+		size_t fileSize = 0;
+		size_t compactSize = 0;
+		bool started = false;
+};
+
+extern Journal g_journal;
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * The Ruby Server - a free and open-source Pokémon MMORPG server emulator
+ * Copyright (C) 2018  Mark Samman (TFS) <mark.samman@gmail.com>
+ *                     Leandro Matheus <kesuhige@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FS_KNOWNCREATURES_H_7C4A1E93B2D84F6A9E05D3B8C1F6A272
+#define FS_KNOWNCREATURES_H_7C4A1E93B2D84F6A9E05D3B8C1F6A272
+
+// Creature ids a client knows, the least recently used one out of view is
+// replaced once all of them are taken. Entries are linked by slot index
+// and found through an open addressing table, so nothing allocates after
+// the construction and every operation is amortized O(1).
+class KnownCreatures
+{
+	public:
+		static constexpr uint16_t CAPACITY = 1300;
+
+		KnownCreatures() : entries(CAPACITY), buckets(BUCKETS, static_cast<uint16_t>(NONE)) {}
+
+		// moves a known id to the front
+		bool touch(uint32_t id) {
+			uint16_t slot = find(id);
+			if (slot == NONE) {
+				return false;
+			}
+
+			unlink(slot);
+			pushFront(slot);
+			return true;
+		}
+
+		// adds an id that is not known yet, returns the one it replaced or 0;
+		// ids still visible to the client move to the front instead, so the
+		// search is bounded by what is in view
+		template <typename Visible>
+		uint32_t insert(uint32_t id, Visible isVisible) {
+			uint32_t removed = 0;
+			uint16_t slot;
+			if (used < CAPACITY) {
+				slot = used++;
+			} else {
+				// nobody out of view, the least recent one goes anyway
+				for (uint16_t tries = 1; tries < CAPACITY && isVisible(entries[tail].id); ++tries) {
+					slot = tail;
+					unlink(slot);
+					pushFront(slot);
+				}
+
+				slot = tail;
+				removed = entries[slot].id;
+				unlink(slot);
+				eraseBucket(removed);
+			}
+
+			entries[slot].id = id;
+			pushFront(slot);
+
+			uint32_t bucket = hash(id);
+			while (buckets[bucket] != NONE) {
+				bucket = (bucket + 1) & (BUCKETS - 1);
+			}
+			buckets[bucket] = slot;
+			return removed;
+		}
+
+	private:
+		static constexpr uint16_t NONE = 0xFFFF;
+		static constexpr uint32_t BUCKETS = 4096; // a power of two, above twice the capacity
+
+		struct Entry {
+			uint32_t id = 0;
+			uint16_t prev = NONE;
+			uint16_t next = NONE;
+		};
+
+		static uint32_t hash(uint32_t id) {
+			return (id * 2654435761u) >> 20;
+		}
+
+		uint16_t find(uint32_t id) const {
+			for (uint32_t bucket = hash(id); buckets[bucket] != NONE; bucket = (bucket + 1) & (BUCKETS - 1)) {
+				if (entries[buckets[bucket]].id == id) {
+					return buckets[bucket];
+				}
+			}
+			return NONE;
+		}
+
+		void eraseBucket(uint32_t id) {
+			uint32_t bucket = hash(id);
+			while (entries[buckets[bucket]].id != id) {
+				bucket = (bucket + 1) & (BUCKETS - 1);
+			}
+
+			// pull back the entries that probed past the freed bucket
+			uint32_t next = bucket;
+			while (true) {
+				next = (next + 1) & (BUCKETS - 1);
+				if (buckets[next] == NONE) {
+					break;
+				}
+
+				uint32_t home = hash(entries[buckets[next]].id);
+				if (((next - home) & (BUCKETS - 1)) >= ((next - bucket) & (BUCKETS - 1))) {
+					buckets[bucket] = buckets[next];
+					bucket = next;
+				}
+			}
+			buckets[bucket] = NONE;
+		}
+
+		void unlink(uint16_t slot) {
+			Entry& entry = entries[slot];
+			if (entry.prev != NONE) {
+				entries[entry.prev].next = entry.next;
+			} else {
+				head = entry.next;
+			}
+
+			if (entry.next != NONE) {
+				entries[entry.next].prev = entry.prev;
+			} else {
+				tail = entry.prev;
+			}
+		}
+
+		void pushFront(uint16_t slot) {
+			Entry& entry = entries[slot];
+			entry.prev = NONE;
+			entry.next = head;
+			if (head != NONE) {
+				entries[head].prev = slot;
+			} else {
+				tail = slot;
+			}
+			head = slot;
+		}
+
+		std::vector<Entry> entries;
+		std::vector<uint16_t> buckets;
+		uint16_t head = NONE;
+		uint16_t tail = NONE;
+		uint16_t used = 0;
+};
+
+#endif
@@ -3823,6 +3823,7 @@ const luaL_Reg LuaScriptInterface::luaDatabaseTable[] = {
 	{"escapeBlob", LuaScriptInterface::luaDatabaseEscapeBlob},
 	{"lastInsertId", LuaScriptInterface::luaDatabaseLastInsertId},
 	{"tableExists", LuaScriptInterface::luaDatabaseTableExists},
+	{"getAsyncStats", LuaScriptInterface::luaDatabaseGetAsyncStats},
 	{nullptr, nullptr}
 };
 
@@ -3931,6 +3932,19 @@ int LuaScriptInterface::luaDatabaseTableExists(lua_State* L)
 	return 1;
 }
 
+int LuaScriptInterface::luaDatabaseGetAsyncStats(lua_State* L)
+{
+	// db.getAsyncStats()
+	DatabaseTaskStats stats = g_databaseTasks.getStats();
+	lua_createtable(L, 0, 5);
+	setField(L, "queued", stats.queued);
+	setField(L, "running", stats.running);
+	setField(L, "executed", stats.executed);
+	setField(L, "averageLatency", stats.averageLatency);
+	setField(L, "maxLatency", stats.maxLatency);
+	return 1;
+}
+
 const luaL_Reg LuaScriptInterface::luaResultTable[] = {
 	{"getNumber", LuaScriptInterface::luaResultGetNumber},
 	{"getString", LuaScriptInterface::luaResultGetString},
@@ -4089,8 +4103,8 @@ int LuaScriptInterface::luaGameGetPlayers(lua_State* L)
 	lua_createtable(L, g_game.getPlayersOnline(), 0);
 
 	int index = 0;
-	for (const auto& playerEntry : g_game.getPlayers()) {
-		pushUserdata<Player>(L, playerEntry.second);
+	for (Player* player : g_game.getPlayers()) {
+		pushUserdata<Player>(L, player);
 		setMetatable(L, -1, "Player");
 		lua_rawseti(L, -2, ++index);
 	}
@@ -7850,7 +7864,7 @@ int LuaScriptInterface::luaPlayerCreate(lua_State* L)
 	Player* player;
 	if (isNumber(L, 2)) {
 		uint32_t id = getNumber<uint32_t>(L, 2);
-		if (id >= 0x10000000 && id <= Player::playerAutoID) {
+		if (g_game.isPlayerID(id)) {
 			player = g_game.getPlayerByID(id);
 		} else {
 			player = g_game.getPlayerByGUID(id);
@@ -8021,6 +8035,12 @@ int LuaScriptInterface::luaPlayerGetDepotChest(lua_State* L)
 		return 1;
 	}
 
+	// scripts expect the items to be there right away
+	if (!IOLoginData::loadStoredItems(player)) {
+		lua_pushnil(L);
+		return 1;
+	}
+
 	uint32_t depotId = getNumber<uint32_t>(L, 2);
 	bool autoCreate = getBoolean(L, 3, false);
 	DepotChest* depotChest = player->getDepotChest(depotId, autoCreate);
@@ -8043,6 +8063,11 @@ int LuaScriptInterface::luaPlayerGetInbox(lua_State* L)
 		return 1;
 	}
 
+	if (!IOLoginData::loadStoredItems(player)) {
+		lua_pushnil(L);
+		return 1;
+	}
+
 	Inbox* inbox = player->getInbox();
 	if (inbox) {
 		pushUserdata<Item>(L, inbox);
@@ -9448,9 +9473,20 @@ int LuaScriptInterface::luaPlayerGetClient(lua_State* L)
 	// player:getClient()
 	Player* player = getUserdata<Player>(L, 1);
 	if (player) {
-		lua_createtable(L, 0, 2);
+		lua_createtable(L, 0, 6);
 		setField(L, "version", player->getProtocolVersion());
 		setField(L, "os", player->getOperatingSystem());
+
+		const ProtocolGame_ptr& client = player->getClient();
+		if (client) {
+			setField(L, "memory", client->getMemoryUsage());
+		}
+
+		if (client && client->isCompressionEnabled()) {
+			setField(L, "compressedBytes", client->getCompressionInputBytes());
+			setField(L, "savedBytes", client->getCompressionInputBytes() - client->getCompressionOutputBytes());
+			setField(L, "compressionTime", client->getCompressionTime());
+		}
 	} else {
 		lua_pushnil(L);
 	}
@@ -9556,18 +9592,10 @@ int LuaScriptInterface::luaPlayerSetGhostMode(lua_State* L)
 	}
 
 	if (player->isInGhostMode()) {
-		for (const auto& it : g_game.getPlayers()) {
-			if (!it.second->isAccessPlayer()) {
-				it.second->notifyStatusChange(player, VIPSTATUS_OFFLINE);
-			}
-		}
+		g_game.notifyVIPWatchers(player, VIPSTATUS_OFFLINE, true);
 		IOLoginData::updateOnlineStatus(player->getGUID(), false);
 	} else {
-		for (const auto& it : g_game.getPlayers()) {
-			if (!it.second->isAccessPlayer()) {
-				it.second->notifyStatusChange(player, VIPSTATUS_ONLINE);
-			}
-		}
+		g_game.notifyVIPWatchers(player, VIPSTATUS_ONLINE, true);
 		IOLoginData::updateOnlineStatus(player->getGUID(), true);
 	}
 	pushBoolean(L, true);
@@ -9671,7 +9699,7 @@ int LuaScriptInterface::luaPokemonCreate(lua_State* L)
 	Pokemon* pokemon;
 	if (isNumber(L, 2)) {
 		uint32_t id = getNumber<uint32_t>(L, 2);
-		if (id >= 0x10000000 && id <= Pokemon::pokemonAutoID) {
+		if (g_game.isPokemonID(id)) {
 			pokemon = g_game.getPokemonByID(id);
 		} else {
 			pokemon = g_game.getPokemonByGUID(id);
@@ -397,7 +397,7 @@ class LuaScriptInterface
 		static const luaL_Reg luaBitReg[7];
 #endif
 		static const luaL_Reg luaConfigManagerTable[4];
-		static const luaL_Reg luaDatabaseTable[9];
+		static const luaL_Reg luaDatabaseTable[10];
 		static const luaL_Reg luaResultTable[6];
 
 		static int protectedCall(lua_State* L, int nargs, int nresults);
@@ -502,6 +502,7 @@ class LuaScriptInterface
 		static int luaDatabaseEscapeBlob(lua_State* L);
 		static int luaDatabaseLastInsertId(lua_State* L);
 		static int luaDatabaseTableExists(lua_State* L);
+		static int luaDatabaseGetAsyncStats(lua_State* L);
 
 		static int luaResultGetNumber(lua_State* L);
 		static int luaResultGetString(lua_State* L);
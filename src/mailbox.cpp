@@ -115,6 +115,11 @@ bool Mailbox::sendItem(Item* item) const
 			return false;
 		}
 
+		// its login is reading an older copy, the letter stays until it can be sent again
+		if (IOLoginData::isLoadingPlayer(tmpPlayer.getGUID())) {
+			return false;
+		}
+
 		if (g_game.internalMoveItem(item->getParent(), tmpPlayer.getInbox(), INDEX_WHEREEVER,
 		                            item, item->getItemCount(), nullptr, FLAG_NOLIMIT) == RETURNVALUE_NOERROR) {
 			g_game.transformItem(item, item->getID() + 1);
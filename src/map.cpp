@@ -24,6 +24,7 @@
 #include "iomapserialize.h"
 #include "combat.h"
 #include "creature.h"
+#include "databasetasks.h"
 #include "game.h"
 
 extern Game g_game;
@@ -47,32 +48,55 @@ bool Map::loadMap(const std::string& identifier, bool loadHouses)
 
 		IOMapSerialize::loadHouseInfo();
 		IOMapSerialize::loadHouseItems(this);
+
+		// the database already holds what was just loaded
+		for (const auto& it : houses.getHouses()) {
+			it.second->setItemsChanged(false);
+		}
 	}
 	return true;
 }
 
-bool Map::save()
+void Map::save(std::function<void(bool)> callback/* = nullptr*/)
 {
-	bool saved = false;
-	for (uint32_t tries = 0; tries < 3; tries++) {
-		if (IOMapSerialize::saveHouseInfo()) {
-			saved = true;
-			break;
+	auto snapshot = std::make_shared<HouseSaveSnapshot>();
+	IOMapSerialize::snapshotHouses(*snapshot);
+
+	g_databaseTasks.addWork([snapshot, callback]() {
+		//database task thread
+		bool saved = false;
+		for (uint32_t tries = 0; tries < 3; tries++) {
+			if (IOMapSerialize::saveHouseInfo(*snapshot)) {
+				saved = true;
+				break;
+			}
 		}
-	}
 
-	if (!saved) {
-		return false;
-	}
+		if (saved) {
+			saved = false;
+			for (uint32_t tries = 0; tries < 3; tries++) {
+				if (IOMapSerialize::saveHouseItems(*snapshot)) {
+					saved = true;
+					break;
+				}
+			}
+		}
+
+		if (!saved && !snapshot->changedHouses.empty()) {
+			// try these houses again on the next save
+			g_dispatcher.addTask(createTask([snapshot]() {
+				for (uint32_t houseId : snapshot->changedHouses) {
+					if (House* house = g_game.map.houses.getHouse(houseId)) {
+						house->setItemsChanged(true);
+					}
+				}
+			}));
+		}
 
-	saved = false;
-	for (uint32_t tries = 0; tries < 3; tries++) {
-		if (IOMapSerialize::saveHouseItems()) {
-			saved = true;
-			break;
+		if (callback) {
+			callback(saved);
 		}
-	}
-	return saved;
+	}, DATABASE_ORDER_HOUSES);
 }
 
 Tile* Map::getTile(uint16_t x, uint16_t y, uint8_t z) const
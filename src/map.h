@@ -188,10 +188,10 @@ class Map
 		bool loadMap(const std::string& identifier, bool loadHouses);
 
 		/**
-		  * Save a map.
-		  * \returns true if the map was saved successfully
+		  * Save a map. The houses are copied right away and written on a
+		  * database task thread, which also runs the callback.
 		  */
-		static bool save();
+		static void save(std::function<void(bool)> callback = nullptr);
 
 		/**
 		  * Get a single tile.
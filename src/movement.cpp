@@ -311,27 +311,40 @@ uint32_t MoveEvents::onCreatureMove(Creature* creature, const Tile* tile, MoveEv
 	return ret;
 }
 
+static void showPokemonPortrait(Player* player, Pokemon* pokemon)
+{
+	Item* portrait = player->getInventoryItem(CONST_SLOT_PORTRAIT);
+	if (portrait) {
+		g_game.transformItem(portrait, pokemon->getPortrait());
+	} else {
+		Item* item = Item::CreateItem(pokemon->getPortrait(), 1);
+		g_game.internalPlayerAddItem(player, item, false, CONST_SLOT_PORTRAIT);
+	}
+
+	pokemon->setLevel(player->getLevel());
+	player->setPokemonHealthMax(pokemon->getMaxHealth());
+	player->setPokemonHealth(pokemon->getHealth());
+	player->sendStats();
+}
+
 uint32_t MoveEvents::onPlayerEquip(Player* player, Item* item, slots_t slot, bool isCheck)
 {
 	// portrait appear
 	if ((item->getSlotPosition() & SLOTP_POKEBALL) && (item->hasAttribute(ITEM_ATTRIBUTE_POKEMONID))) {
-		Pokemon* pokemon = g_game.getPokemonByGUID(item->getPokemonId());
-		if (!pokemon) {
-			return 0;
-		}
-
-		Item* portrait = player->getInventoryItem(CONST_SLOT_PORTRAIT);
-		if (portrait) {
-			g_game.transformItem(portrait, pokemon->getPortrait());
-		} else {
-			Item* item = Item::CreateItem(pokemon->getPortrait(), 1);
-			g_game.internalPlayerAddItem(player, item, false, CONST_SLOT_PORTRAIT);
+		if (Pokemon* pokemon = g_game.getLoadedPokemonByGUID(item->getPokemonId())) {
+			showPokemonPortrait(player, pokemon);
+		} else if (!isCheck) {
+			// the ball goes in now, its portrait once the pokemon is loaded
+			uint32_t playerId = player->getID();
+			item->incrementReferenceCounter();
+			g_game.loadPokemon(item->getPokemonId(), [playerId, item](Pokemon* pokemon) {
+				Player* player = g_game.getPlayerByID(playerId);
+				if (pokemon && player && player->getInventoryItem(CONST_SLOT_POKEBALL) == item) {
+					showPokemonPortrait(player, pokemon);
+				}
+				g_game.ReleaseItem(item);
+			});
 		}
-
-		pokemon->setLevel(player->getLevel());
-		player->setPokemonHealthMax(pokemon->getMaxHealth());
-		player->setPokemonHealth(pokemon->getHealth());
-		player->sendStats();
 	}
 
 	MoveEvent* moveEvent = getEvent(item, MOVE_EVENT_EQUIP, slot);
@@ -24,6 +24,90 @@
 
 #include "container.h"
 #include "creature.h"
+#include "lockfree.h"
+
+namespace {
+
+template <size_t SIZE>
+struct MessageBuffer
+{
+	uint8_t data[SIZE];
+};
+
+using SmallMessageBuffer = MessageBuffer<NetworkMessage::SMALL_BUFFER_SIZE>;
+using MediumMessageBuffer = MessageBuffer<NetworkMessage::MEDIUM_BUFFER_SIZE>;
+using LargeMessageBuffer = MessageBuffer<NetworkMessage::LARGE_BUFFER_SIZE>;
+
+// free lists are bounded, so at most a few MB of released buffers stay pooled
+using SmallBufferAllocator = LockfreePoolingAllocator<SmallMessageBuffer, 4096>;
+using MediumBufferAllocator = LockfreePoolingAllocator<MediumMessageBuffer, 1024>;
+using LargeBufferAllocator = LockfreePoolingAllocator<LargeMessageBuffer, 64>;
+
+uint8_t* acquireBuffer(size_t size, NetworkMessage::MsgSize_t& capacity)
+{
+	if (size <= NetworkMessage::SMALL_BUFFER_SIZE) {
+		capacity = NetworkMessage::SMALL_BUFFER_SIZE;
+		return reinterpret_cast<uint8_t*>(SmallBufferAllocator(nullptr).allocate(1));
+	} else if (size <= NetworkMessage::MEDIUM_BUFFER_SIZE) {
+		capacity = NetworkMessage::MEDIUM_BUFFER_SIZE;
+		return reinterpret_cast<uint8_t*>(MediumBufferAllocator(nullptr).allocate(1));
+	}
+
+	capacity = NetworkMessage::LARGE_BUFFER_SIZE;
+	return reinterpret_cast<uint8_t*>(LargeBufferAllocator(nullptr).allocate(1));
+}
+
+void releaseBuffer(uint8_t* buffer, NetworkMessage::MsgSize_t capacity)
+{
+	switch (capacity) {
+		case NetworkMessage::SMALL_BUFFER_SIZE:
+			SmallBufferAllocator(nullptr).deallocate(reinterpret_cast<SmallMessageBuffer*>(buffer), 1);
+			break;
+		case NetworkMessage::MEDIUM_BUFFER_SIZE:
+			MediumBufferAllocator(nullptr).deallocate(reinterpret_cast<MediumMessageBuffer*>(buffer), 1);
+			break;
+		default:
+			LargeBufferAllocator(nullptr).deallocate(reinterpret_cast<LargeMessageBuffer*>(buffer), 1);
+			break;
+	}
+}
+
+}
+
+NetworkMessage::NetworkMessage(size_t expectedSize/* = 0*/)
+{
+	buffer = acquireBuffer(expectedSize + INITIAL_BUFFER_POSITION, capacity);
+}
+
+NetworkMessage::~NetworkMessage()
+{
+	releaseBuffer(buffer, capacity);
+}
+
+void NetworkMessage::reserve(size_t size)
+{
+	if (size <= capacity) {
+		return;
+	}
+
+	MsgSize_t newCapacity;
+	uint8_t* newBuffer = acquireBuffer(size, newCapacity);
+	memcpy(newBuffer, buffer, capacity);
+	releaseBuffer(buffer, capacity);
+
+	buffer = newBuffer;
+	capacity = newCapacity;
+}
+
+void NetworkMessage::shrink()
+{
+	if (capacity == SMALL_BUFFER_SIZE) {
+		return;
+	}
+
+	releaseBuffer(buffer, capacity);
+	buffer = acquireBuffer(SMALL_BUFFER_SIZE, capacity);
+}
 
 std::string NetworkMessage::getString(uint16_t stringLen/* = 0*/)
 {
@@ -44,7 +44,18 @@ class NetworkMessage
 		enum { MAX_BODY_LENGTH = NETWORKMESSAGE_MAXSIZE - HEADER_LENGTH - CHECKSUM_LENGTH - XTEA_MULTIPLE };
 		enum { MAX_PROTOCOL_BODY_LENGTH = MAX_BODY_LENGTH - 10 };
 
-		NetworkMessage() = default;
+		// Buffers come in a few size classes and grow on demand, so small
+		// packets and idle connections don't pin a full-sized buffer
+		enum { SMALL_BUFFER_SIZE = 256 };
+		enum { MEDIUM_BUFFER_SIZE = 2048 };
+		enum { LARGE_BUFFER_SIZE = NETWORKMESSAGE_MAXSIZE };
+
+		explicit NetworkMessage(size_t expectedSize = 0);
+		~NetworkMessage();
+
+		// non-copyable
+		NetworkMessage(const NetworkMessage&) = delete;
+		NetworkMessage& operator=(const NetworkMessage&) = delete;
 
 		void reset() {
 			info = {};
@@ -150,6 +161,15 @@ class NetworkMessage
 			return buffer + HEADER_LENGTH;
 		}
 
+		MsgSize_t getCapacity() const {
+			return capacity;
+		}
+
+		// makes room for size bytes from the start of the buffer
+		void reserve(size_t size);
+		// drops back to the smallest buffer, discarding its contents
+		void shrink();
+
 	protected:
 		struct NetworkMessageInfo {
 			MsgSize_t length = 0;
@@ -158,15 +178,23 @@ class NetworkMessage
 		};
 
 		NetworkMessageInfo info;
-		uint8_t buffer[NETWORKMESSAGE_MAXSIZE];
+		uint8_t* buffer;
+		MsgSize_t capacity;
 
 	private:
-		bool canAdd(size_t size) const {
-			return (size + info.position) < MAX_BODY_LENGTH;
+		bool canAdd(size_t size) {
+			if ((size + info.position) >= MAX_BODY_LENGTH) {
+				return false;
+			}
+
+			if ((size + info.position) > capacity) {
+				reserve(size + info.position);
+			}
+			return true;
 		}
 
 		bool canRead(int32_t size) {
-			if ((info.position + size) > (info.length + 8) || size >= (NETWORKMESSAGE_MAXSIZE - info.position)) {
+			if ((info.position + size) > (info.length + 8) || size >= (capacity - info.position)) {
 				info.overrun = true;
 				return false;
 			}
@@ -29,21 +29,22 @@ extern ConfigManager g_config;
 extern Game g_game;
 extern LuaEnvironment g_luaEnvironment;
 
-uint32_t Npc::npcAutoID = 0x80000000;
 NpcScriptInterface* Npc::scriptInterface = nullptr;
 
 void Npcs::reload()
 {
-	const std::map<uint32_t, Npc*>& npcs = g_game.getNpcs();
-	for (const auto& it : npcs) {
-		it.second->closeAllShopWindows();
+	// reloading takes them out of the game list and back in, go over a copy
+	const auto& gameNpcs = g_game.getNpcs();
+	std::vector<Npc*> npcs(gameNpcs.begin(), gameNpcs.end());
+	for (Npc* npc : npcs) {
+		npc->closeAllShopWindows();
 	}
 
 	delete Npc::scriptInterface;
 	Npc::scriptInterface = nullptr;
 
-	for (const auto& it : npcs) {
-		it.second->reload();
+	for (Npc* npc : npcs) {
+		npc->reload();
 	}
 }
 
@@ -71,6 +72,13 @@ Npc::~Npc()
 	reset();
 }
 
+void Npc::setID()
+{
+	if (id == 0) {
+		id = g_game.reserveCreatureID(CREATURETYPE_NPC);
+	}
+}
+
 void Npc::addList()
 {
 	g_game.addNpc(this);
@@ -118,8 +126,11 @@ void Npc::reset()
 
 void Npc::reload()
 {
+	// the name may change with the file, take it out of the game indexes meanwhile
+	removeList();
 	reset();
 	load();
+	addList();
 
 	// Simulate that the creature is placed on the map again.
 	if (npcEventHandler) {
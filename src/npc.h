@@ -122,11 +122,7 @@ class Npc final : public Creature
 			return pushable && walkTicks != 0;
 		}
 
-		void setID() override {
-			if (id == 0) {
-				id = npcAutoID++;
-			}
-		}
+		void setID() override;
 
 		void removeList() override;
 		void addList() override;
@@ -184,7 +180,6 @@ class Npc final : public Creature
 
 		NpcScriptInterface* getScriptInterface();
 
-		static uint32_t npcAutoID;
 
 	private:
 		explicit Npc(const std::string& name);
@@ -34,9 +34,14 @@
 #include "databasemanager.h"
 #include "scheduler.h"
 #include "databasetasks.h"
+#include "databaseworkers.h"
+#include "iologindata.h"
+#include "journal.h"
 #include <fstream>
 
 DatabaseTasks g_databaseTasks;
+Journal g_journal;
+DatabaseWorkers g_databaseWorkers;
 Dispatcher g_dispatcher;
 Scheduler g_scheduler;
 
@@ -88,11 +93,15 @@ int main(int argc, char* argv[])
 		std::cout << ">> No services running. The server is NOT online." << std::endl;
 		g_scheduler.shutdown();
 		g_databaseTasks.shutdown();
+		g_databaseWorkers.shutdown();
 		g_dispatcher.shutdown();
 	}
 
+	HandshakeWorkers::getInstance().shutdown();
+
 	g_scheduler.join();
 	g_databaseTasks.join();
+	g_databaseWorkers.join();
 	g_dispatcher.join();
 	return 0;
 }
@@ -161,13 +170,16 @@ void mainLoader(int, char*[], ServiceManager* services)
 	//set RSA key
 	const char* p(g_config.getString(ConfigManager::PRIME1).c_str());
 	const char* q(g_config.getString(ConfigManager::PRIME2).c_str());
-	g_RSA.setKey(p, q);
-
 	if ((*p == 0) || (*q == 0)) {
 		startupErrorMessage("The RSA key is invalid.");
 		return;
 	}
 
+	g_RSA.setKey(p, q);
+
+	std::cout << ">> RSA decryption: " << g_RSA.getDecryptionsPerSecond() << " handshakes per second per core" << std::endl;
+	HandshakeWorkers::getInstance().start(g_config.getNumber(ConfigManager::HANDSHAKE_WORKER_THREADS));
+
 	std::cout << ">> Establishing database connection..." << std::flush;
 
 	if (!Database::getInstance().connect()) {
@@ -184,7 +196,27 @@ void mainLoader(int, char*[], ServiceManager* services)
 		startupErrorMessage("The database you have specified in config.lua is empty, please import the schema.sql to your database.");
 		return;
 	}
-	g_databaseTasks.start();
+	if (!g_databaseTasks.start(g_config.getNumber(ConfigManager::DATABASE_TASK_THREADS))) {
+		startupErrorMessage("Failed to connect the database task threads.");
+		return;
+	}
+
+	if (!g_databaseWorkers.start(g_config.getNumber(ConfigManager::DATABASE_WORKER_THREADS))) {
+		startupErrorMessage("Failed to connect the database worker threads.");
+		return;
+	}
+
+	if (!DatabaseManager::columnExists("characters", "save_sequence")) {
+		startupErrorMessage("The characters table has no save_sequence column, please run: ALTER TABLE `characters` ADD `save_sequence` bigint(20) UNSIGNED NOT NULL DEFAULT '0' AFTER `save`;");
+		return;
+	}
+
+	// whatever a crash kept from being saved goes in before anyone logs in
+	std::cout << ">> Replaying journal" << std::endl;
+	if (!g_journal.load(g_config.getString(ConfigManager::JOURNAL_FILE)) || !IOLoginData::replayJournal() || !g_journal.start()) {
+		startupErrorMessage("Failed to replay the journal.");
+		return;
+	}
 
 	if (g_config.getBoolean(ConfigManager::OPTIMIZE_DATABASE) && !DatabaseManager::optimizeTables()) {
 		std::cout << "> No tables were optimized." << std::endl;
@@ -300,6 +332,12 @@ void mainLoader(int, char*[], ServiceManager* services)
 
 	g_game.map.houses.payHouses(rentPeriod);
 
+	std::cout << ">> Loading market offers" << std::endl;
+	if (!IOMarket::getInstance().loadOffers()) {
+		startupErrorMessage("Unable to load market offers!");
+		return;
+	}
+
 	IOMarket::checkExpiredOffers();
 	IOMarket::getInstance().updateStatistics();
 
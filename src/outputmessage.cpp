@@ -78,7 +78,7 @@ void OutputMessagePool::removeProtocolFromAutosend(const Protocol_ptr& protocol)
 	}
 }
 
-OutputMessage_ptr OutputMessagePool::getOutputMessage()
+OutputMessage_ptr OutputMessagePool::getOutputMessage(size_t expectedSize/* = 0*/)
 {
-	return std::allocate_shared<OutputMessage>(OutputMessageAllocator());
+	return std::allocate_shared<OutputMessage>(OutputMessageAllocator(), expectedSize);
 }
@@ -30,7 +30,7 @@ class Protocol;
 class OutputMessage : public NetworkMessage
 {
 	public:
-		OutputMessage() = default;
+		explicit OutputMessage(size_t expectedSize = 0) : NetworkMessage(expectedSize) {}
 
 		// non-copyable
 		OutputMessage(const OutputMessage&) = delete;
@@ -40,8 +40,11 @@ class OutputMessage : public NetworkMessage
 			return buffer + outputBufferStart;
 		}
 
-		void writeMessageLength() {
-			add_header(info.length);
+		// compressed bodies are flagged in the high bit of the inner length
+		enum { COMPRESSED_LENGTH_FLAG = 0x8000 };
+
+		void writeMessageLength(bool compressed = false) {
+			add_header<MsgSize_t>(compressed ? (info.length | COMPRESSED_LENGTH_FLAG) : info.length);
 		}
 
 		void addCryptoHeader(bool addChecksum) {
@@ -52,8 +55,15 @@ class OutputMessage : public NetworkMessage
 			writeMessageLength();
 		}
 
+		void setBody(const uint8_t* bytes, MsgSize_t size) {
+			memcpy(buffer + outputBufferStart, bytes, size);
+			info.length = size;
+			info.position = outputBufferStart + size;
+		}
+
 		void append(const NetworkMessage& msg) {
 			auto msgLen = msg.getLength();
+			reserve(info.position + msgLen);
 			memcpy(buffer + info.position, msg.getBuffer() + 8, msgLen);
 			info.length += msgLen;
 			info.position += msgLen;
@@ -61,6 +71,7 @@ class OutputMessage : public NetworkMessage
 
 		void append(const OutputMessage_ptr& msg) {
 			auto msgLen = msg->getLength();
+			reserve(info.position + msgLen);
 			memcpy(buffer + info.position, msg->getBuffer() + 8, msgLen);
 			info.length += msgLen;
 			info.position += msgLen;
@@ -94,7 +105,7 @@ class OutputMessagePool
 		void sendAll();
 		void scheduleSendAll();
 
-		static OutputMessage_ptr getOutputMessage();
+		static OutputMessage_ptr getOutputMessage(size_t expectedSize = 0);
 
 		void addProtocolToAutosend(Protocol_ptr protocol);
 		void removeProtocolFromAutosend(const Protocol_ptr& protocol);
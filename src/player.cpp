@@ -50,7 +50,6 @@ extern Pokemons g_pokemons;
 
 MuteCountMap Player::muteCountMap;
 
-uint32_t Player::playerAutoID = 0x10000000;
 
 Player::Player(ProtocolGame_ptr p) :
 	Creature(), lastPing(OTSYS_TIME()), lastPong(lastPing), inbox(new Inbox(ITEM_INBOX)), client(std::move(p))
@@ -74,6 +73,10 @@ Player::~Player()
 
 	inbox->decrementReferenceCounter();
 
+	for (Pokemon* pokemon : pendingPokemons) {
+		delete pokemon;
+	}
+
 	setWriteItem(nullptr);
 	setEditHouse(nullptr);
 }
@@ -512,7 +515,10 @@ void Player::addStorageValue(const uint32_t key, const int32_t value, const bool
 				value >> 16,
 				value & 0xFF
 			);
-			return;
+			// kept at login too, the map has to match the stored rows
+			if (!isLogin) {
+				return;
+			}
 		} else if (IS_IN_KEYRANGE(key, POKEDEX_RANGE)) {
 			addPokedexEntry(value);
 		} else if (IS_IN_KEYRANGE(key, MOUNTS_RANGE)) {
@@ -527,7 +533,7 @@ void Player::addStorageValue(const uint32_t key, const int32_t value, const bool
 		int32_t oldValue;
 		getStorageValue(key, oldValue);
 
-		storageMap[key] = value;
+		storageMap.set(key, value);
 
 		if (!isLogin) {
 			auto currentFrameTime = g_dispatcher.getDispatcherCycle();
@@ -543,14 +549,7 @@ void Player::addStorageValue(const uint32_t key, const int32_t value, const bool
 
 bool Player::getStorageValue(const uint32_t key, int32_t& value) const
 {
-	auto it = storageMap.find(key);
-	if (it == storageMap.end()) {
-		value = -1;
-		return false;
-	}
-
-	value = it->second;
-	return true;
+	return storageMap.get(key, value);
 }
 
 bool Player::canSee(const Position& pos) const
@@ -653,8 +652,20 @@ bool Player::isNearDepotBox() const
 	return false;
 }
 
+Inbox* Player::getInbox()
+{
+	if (!storedItemsLoaded) {
+		IOLoginData::loadStoredItemsAsync(this);
+	} else {
+		lastStoredItemsAccess = OTSYS_TIME();
+	}
+	return inbox;
+}
+
 DepotChest* Player::getDepotChest(uint32_t depotId, bool autoCreate)
 {
+	lastStoredItemsAccess = OTSYS_TIME();
+
 	auto it = depotChests.find(depotId);
 	if (it != depotChests.end()) {
 		return it->second;
@@ -673,6 +684,8 @@ DepotChest* Player::getDepotChest(uint32_t depotId, bool autoCreate)
 
 DepotLocker* Player::getDepotLocker(uint32_t depotId)
 {
+	lastStoredItemsAccess = OTSYS_TIME();
+
 	auto it = depotLockerMap.find(depotId);
 	if (it != depotLockerMap.end()) {
 		inbox->setParent(it->second);
@@ -896,6 +909,9 @@ void Player::onCreatureAppear(Creature* creature, bool isLogin)
 	Creature::onCreatureAppear(creature, isLogin);
 
 	if (isLogin && creature == this) {
+		g_game.addLoadedPokemons(pendingPokemons);
+		pendingPokemons.clear();
+
 		sendItems();
 
 		for (int32_t slot = CONST_SLOT_FIRST; slot <= CONST_SLOT_LAST; ++slot) {
@@ -1057,6 +1073,19 @@ void Player::onRemoveCreature(Creature* creature, bool isLogout)
 		if (!saved) {
 			std::cout << "Error while saving player: " << getName() << std::endl;
 		}
+
+		// written behind, a world save batch holding their keys must not stall the logout
+		const std::string& name = getName();
+		IOLoginData::savePokemonsAsync(getLoadedPokemons(), [name](bool saved) {
+			if (!saved) {
+				std::cout << "Error while saving pokemon of player: " << name << std::endl;
+			}
+		});
+
+		const int32_t unloadPokemonsAfterMinutes = g_config.getNumber(ConfigManager::UNLOAD_POKEMONS_AFTER_MINUTES);
+		if (unloadPokemonsAfterMinutes > 0) {
+			g_scheduler.addEvent(createSchedulerTask(unloadPokemonsAfterMinutes * 60000, std::bind(&Game::unloadPokemons, &g_game, guid, getItemPokemonGUIDs())));
+		}
 	}
 }
 
@@ -1338,6 +1367,13 @@ void Player::onThink(uint32_t interval)
 			client->sendTextMessage(TextMessage(MESSAGE_STATUS_WARNING, ss.str()));
 		}
 	}
+
+	const int32_t unloadDepotAfterMinutes = g_config.getNumber(ConfigManager::UNLOAD_DEPOT_AFTER_MINUTES);
+	if (storedItemsLoaded && unloadDepotAfterMinutes > 0 && OTSYS_TIME() - lastStoredItemsAccess > unloadDepotAfterMinutes * 60000) {
+		// not saved or still in use, look again after another while
+		lastStoredItemsAccess = OTSYS_TIME();
+		IOLoginData::unloadStoredItems(this);
+	}
 }
 
 uint32_t Player::isMuted() const
@@ -1797,21 +1833,22 @@ void Player::addInFightTicks(bool pzlock /*= false*/)
 	addCondition(condition);
 }
 
+void Player::setID()
+{
+	if (id == 0) {
+		id = g_game.reserveCreatureID(CREATURETYPE_PLAYER);
+	}
+}
+
 void Player::removeList()
 {
 	g_game.removePlayer(this);
-
-	for (const auto& it : g_game.getPlayers()) {
-		it.second->notifyStatusChange(this, VIPSTATUS_OFFLINE);
-	}
+	g_game.notifyVIPWatchers(this, VIPSTATUS_OFFLINE);
 }
 
 void Player::addList()
 {
-	for (const auto& it : g_game.getPlayers()) {
-		it.second->notifyStatusChange(this, VIPSTATUS_ONLINE);
-	}
-
+	g_game.notifyVIPWatchers(this, VIPSTATUS_ONLINE);
 	g_game.addPlayer(this);
 }
 
@@ -1851,6 +1888,8 @@ bool Player::removeVIP(uint32_t vipGuid)
 		return false;
 	}
 
+	g_game.removeVIPWatcher(vipGuid, this);
+
 	IOLoginData::removeVIPEntry(accountNumber, vipGuid);
 	return true;
 }
@@ -1868,6 +1907,8 @@ bool Player::addVIP(uint32_t vipGuid, const std::string& vipName, VipStatus_t st
 		return false;
 	}
 
+	g_game.addVIPWatcher(vipGuid, this);
+
 	IOLoginData::addVIPEntry(accountNumber, vipGuid, "", 0, false);
 	if (client) {
 		client->sendVIP(vipGuid, vipName, "", 0, false, status);
@@ -2558,6 +2599,8 @@ Thing* Player::getThing(size_t index) const
 
 void Player::postAddNotification(Thing* thing, const Cylinder* oldParent, int32_t index, cylinderlink_t link /*= LINK_OWNER*/)
 {
+	itemsChanged = true;
+
 	if (link == LINK_OWNER) {
 		//calling movement scripts
 		g_moveEvents->onPlayerEquip(this, thing->getItem(), static_cast<slots_t>(index), false);
@@ -2613,6 +2656,8 @@ void Player::postAddNotification(Thing* thing, const Cylinder* oldParent, int32_
 
 void Player::postRemoveNotification(Thing* thing, const Cylinder* newParent, int32_t index, cylinderlink_t link /*= LINK_OWNER*/)
 {
+	itemsChanged = true;
+
 	if (link == LINK_OWNER) {
 		//calling movement scripts
 		g_moveEvents->onPlayerDeEquip(this, thing->getItem(), static_cast<slots_t>(index));
@@ -3223,13 +3268,15 @@ void Player::genReservedStorageRange()
 	//generate outfits range
 	uint32_t base_key = PSTRG_OUTFITS_RANGE_START;
 	for (const OutfitEntry& entry : outfits) {
-		storageMap[++base_key] = (entry.lookType << 16) | entry.addons;
+		storageMap.set(++base_key, (entry.lookType << 16) | entry.addons);
 	}
+	storageMap.erase(base_key + 1, PSTRG_OUTFITS_RANGE_START + PSTRG_OUTFITS_RANGE_SIZE);
 	//generate pokedex range
 	base_key = PSTRG_POKEDEX_RANGE_START;
 	for (const PokedexEntry& entry : pokedexEntries) {
-		storageMap[++base_key] = (entry.pokemonNumber << 16);
+		storageMap.set(++base_key, (entry.pokemonNumber << 16));
 	}
+	storageMap.erase(base_key + 1, PSTRG_POKEDEX_RANGE_START + PSTRG_POKEDEX_RANGE_SIZE);
 }
 
 void Player::addOutfit(uint16_t lookType, uint8_t addons)
@@ -3472,6 +3519,7 @@ void Player::tryCatchPokemon(const PokeballType* pokeballType, Item* corpse, dou
 		if (!IOLoginData::savePokemon(pokemon)) {
 			return;
 		}
+		g_game.addLoadedPokemons({pokemon});
 
 		tryEffect = pokeballType->getCatchSuccessEffect();
 		pokemonEmot = CONST_ME_EMOT_EXCLAMATION;
@@ -3495,6 +3543,52 @@ void Player::tryCatchPokemon(const PokeballType* pokeballType, Item* corpse, dou
 	g_scheduler.addEvent(createSchedulerTask(3000 + delay, std::bind(&Game::playerSendTextMessage, &g_game, getID(), MESSAGE_STATUS_CONSOLE_BLUE, message.str())));
 }
 
+std::vector<Pokemon*> Player::getLoadedPokemons() const
+{
+	std::vector<Pokemon*> pokemons;
+	for (uint32_t pokemonId : getItemPokemonGUIDs()) {
+		if (Pokemon* pokemon = g_game.getLoadedPokemonByGUID(pokemonId)) {
+			pokemons.push_back(pokemon);
+		}
+	}
+	return pokemons;
+}
+
+std::vector<uint32_t> Player::getItemPokemonGUIDs() const
+{
+	std::vector<uint32_t> pokemonIds;
+	auto addPokemon = [&pokemonIds](const Item* item) {
+		if (item->getPokemonId() != 0) {
+			pokemonIds.push_back(item->getPokemonId());
+		}
+	};
+
+	std::vector<const Container*> containers;
+	for (int32_t i = CONST_SLOT_FIRST; i <= CONST_SLOT_LAST; i++) {
+		Item* item = inventory[i];
+		if (!item) {
+			continue;
+		}
+
+		addPokemon(item);
+		if (const Container* container = item->getContainer()) {
+			containers.push_back(container);
+		}
+	}
+
+	for (const auto& it : depotChests) {
+		containers.push_back(it.second);
+	}
+	containers.push_back(inbox);
+
+	for (const Container* container : containers) {
+		for (ContainerIterator it = container->iterator(); it.hasNext(); it.advance()) {
+			addPokemon(*it);
+		}
+	}
+	return pokemonIds;
+}
+
 void Player::orderPokemon(const Position& toPos, Creature* creature)
 {
 	Pokemon* pokemon = getHisPokemon();
@@ -3700,7 +3794,11 @@ void Player::gobackPokemon(Item* item)
 	} else {
 		pokemon = g_game.getPokemonByGUID(item->getPokemonId());
 		if (!pokemon) {
-			sendTextMessage(MESSAGE_STATUS_CONSOLE_RED, "Pokemon not found! Please contact an administrator.");
+			if (g_game.isLoadingPokemon(item->getPokemonId())) {
+				sendTextMessage(MESSAGE_STATUS_CONSOLE_BLUE, "Your Pokemon is not ready yet, please try again.");
+			} else {
+				sendTextMessage(MESSAGE_STATUS_CONSOLE_RED, "Pokemon not found! Please contact an administrator.");
+			}
 			return;
 		}
 
@@ -40,6 +40,7 @@
 #include "groups.h"
 #include "town.h"
 #include "mounts.h"
+#include "storagemap.h"
 
 class House;
 class NetworkMessage;
@@ -78,6 +79,17 @@ enum tradestate_t : uint8_t {
 	TRADE_TRANSFER,
 };
 
+enum savesection_t : uint8_t {
+	SAVESECTION_FIRST = 0,
+	SAVESECTION_STATS = SAVESECTION_FIRST,
+	SAVESECTION_INVENTORY,
+	SAVESECTION_DEPOT,
+	SAVESECTION_INBOX,
+	SAVESECTION_STORAGE,
+
+	SAVESECTION_LAST = SAVESECTION_STORAGE
+};
+
 struct VIPEntry {
 	VIPEntry(uint32_t guid, std::string name, std::string description, uint32_t icon, bool notify) :
 		guid(guid), name(std::move(name)), description(std::move(description)), icon(icon), notify(notify) {}
@@ -135,11 +147,7 @@ class Player final : public Creature, public Cylinder
 			return this;
 		}
 
-		void setID() override {
-			if (id == 0) {
-				id = playerAutoID++;
-			}
-		}
+		void setID() override;
 
 		static MuteCountMap muteCountMap;
 
@@ -233,8 +241,11 @@ class Player final : public Creature, public Cylinder
 			lastWalkthroughPosition = walkthroughPosition;
 		}
 
-		Inbox* getInbox() const {
-			return inbox;
+		// starts reading the depot and inbox items if the player logged in
+		// without them, items can be added to the inbox meanwhile
+		Inbox* getInbox();
+		bool areStoredItemsLoaded() const {
+			return storedItemsLoaded;
 		}
 
 		uint16_t getClientIcons() const;
@@ -266,6 +277,10 @@ class Player final : public Creature, public Cylinder
 			return client->getVersion();
 		}
 
+		const ProtocolGame_ptr& getClient() const {
+			return client;
+		}
+
 		void setParty(Party* party) {
 			this->party = party;
 		}
@@ -1172,6 +1187,10 @@ class Player final : public Creature, public Cylinder
 		void sendPokemon(Pokemon* pokemon);
 		void orderPokemon(const Position& toPos, Creature* creature);
 		void evolvePokemon(Item* item, Creature* creature);
+
+		// the player's pokemon that are in memory, found through their pokeballs
+		std::vector<Pokemon*> getLoadedPokemons() const;
+		std::vector<uint32_t> getItemPokemonGUIDs() const;
 		bool feed(const FoodType* foodType) override;
 
 	private:
@@ -1227,9 +1246,10 @@ class Player final : public Creature, public Cylinder
 		std::unordered_set<uint32_t> VIPList;
 
 		std::map<uint8_t, OpenContainer> openContainers;
+		std::vector<Pokemon*> pendingPokemons; // read along at login, handed to the game once the player appears
 		std::map<uint32_t, DepotLocker*> depotLockerMap;
 		std::map<uint32_t, DepotChest*> depotChests;
-		std::map<uint32_t, int32_t> storageMap;
+		StorageMap storageMap;
 
 		std::vector<OutfitEntry> outfits;
 		std::vector<PokedexEntry> pokedexEntries;
@@ -1250,12 +1270,20 @@ class Player final : public Creature, public Cylinder
 		SoundEffectClasses listeningMusic = CONST_SE_NONE;
 
 		time_t lastLoginSaved = 0;
+		int64_t savedOnlineTime = 0; // the stored online time up to lastLoginSaved
 		time_t lastLogout = 0;
 
 		uint64_t experience = 0;
 		uint64_t lastAttack = 0;
 		uint64_t bankBalance = 0;
 		uint64_t lastQuestlogUpdate = 0;
+		uint64_t savedDigests[SAVESECTION_LAST + 1] = {}; // what the last written save held of each section
+		uint64_t snapshotDigests[SAVESECTION_LAST + 1] = {}; // same for the last save taken, written or not
+		uint64_t savedSequence = 0;
+		uint64_t journaledDigests[SAVESECTION_LAST + 1] = {}; // same for the last journal records
+		uint64_t journaledExperience = 0;
+		int64_t lastSaveTime = 0;
+		int64_t lastStoredItemsAccess = 0;
 		int64_t lastFailedFollow = 0;
 		int64_t lastWalkthroughAttempt = 0;
 		int64_t lastToggleMount = 0;
@@ -1289,6 +1317,7 @@ class Player final : public Creature, public Cylinder
 		uint32_t conditionImmunities = 0;
 		uint32_t conditionSuppressions = 0;
 		uint32_t level = 1;
+		uint32_t journaledLevel = 0;
 		uint32_t actionTaskEvent = 0;
 		uint32_t nextStepEvent = 0;
 		uint32_t walkTaskEvent = 0;
@@ -1329,9 +1358,10 @@ class Player final : public Creature, public Cylinder
 		bool pzLocked = false;
 		bool isConnecting = false;
 		bool addAttackSkillPoint = false;
+		bool itemsChanged = false; // since they were last journaled
+		bool storedItemsLoaded = true; // depot and inbox items
 		bool inventoryAbilities[CONST_SLOT_LAST + 1] = {};
 
-		static uint32_t playerAutoID;
 
 		void updateItemsLight(bool internal = false);
 		int32_t getStepSpeed() const override {
@@ -34,7 +34,6 @@ extern Events* g_events;
 int32_t Pokemon::despawnRange;
 int32_t Pokemon::despawnRadius;
 
-uint32_t Pokemon::pokemonAutoID = 0x40000000;
 
 Pokemon* Pokemon::createPokemon(const std::string& name, int32_t plevel /* = 1 */, bool spawn /* = true */)
 {
@@ -102,6 +101,13 @@ Pokemon::~Pokemon()
 	clearFriendList();
 }
 
+void Pokemon::setID()
+{
+	if (id == 0) {
+		id = g_game.reserveCreatureID(CREATURETYPE_POKEMON);
+	}
+}
+
 void Pokemon::addList()
 {
 	g_game.addPokemon(this);
@@ -65,11 +65,7 @@ class Pokemon final : public Creature
 			return this;
 		}
 
-		void setID() override {
-			if (id == 0) {
-				id = pokemonAutoID++;
-			}
-		}
+		void setID() override;
 
 		void removeList() override;
 		void addList() override;
@@ -317,7 +313,6 @@ class Pokemon final : public Creature
 		BlockType_t blockHit(Creature* attacker, CombatType_t combatType, int32_t& damage, 
 									 bool field = false) override;
 
-		static uint32_t pokemonAutoID;
 
 		void setGUID(uint32_t guid) {
 			this->guid = guid;
@@ -461,6 +456,7 @@ class Pokemon final : public Creature
 
 		int64_t lastMeleeAttack = 0;
 		int64_t nextEmot = 0;
+		int64_t lastSaveTime = 0;
 
 		uint32_t guid = 0;
 		uint32_t attackTicks = 0;
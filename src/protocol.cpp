@@ -20,16 +20,69 @@
 
 #include "otpch.h"
 
+#include <zlib.h>
+
 #include "protocol.h"
 #include "outputmessage.h"
+#include "configmanager.h"
 #include "rsa.h"
 
 extern RSA g_RSA;
+extern ConfigManager g_config;
+
+namespace {
 
-void Protocol::onSendMessage(const OutputMessage_ptr& msg) const
+// Raw deflate stream owned by a single network thread, reset for every message
+class Deflater
+{
+	public:
+		Deflater() {
+			int32_t level = g_config.getNumber(ConfigManager::PACKET_COMPRESSION_LEVEL);
+			initialized = deflateInit2(&stream, std::min<int32_t>(9, std::max<int32_t>(1, level)), Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+		}
+		~Deflater() {
+			if (initialized) {
+				deflateEnd(&stream);
+			}
+		}
+
+		// non-copyable
+		Deflater(const Deflater&) = delete;
+		Deflater& operator=(const Deflater&) = delete;
+
+		bool deflate(const uint8_t* input, size_t inputSize, size_t& outputSize) {
+			if (!initialized || deflateReset(&stream) != Z_OK) {
+				return false;
+			}
+
+			stream.next_in = const_cast<Bytef*>(input);
+			stream.avail_in = inputSize;
+			stream.next_out = buffer;
+			stream.avail_out = sizeof(buffer);
+			if (::deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+				return false;
+			}
+
+			outputSize = stream.total_out;
+			return true;
+		}
+
+		const uint8_t* getBuffer() const {
+			return buffer;
+		}
+
+	private:
+		z_stream stream = {};
+		uint8_t buffer[NetworkMessage::MAX_BODY_LENGTH];
+		bool initialized = false;
+};
+
+}
+
+void Protocol::onSendMessage(const OutputMessage_ptr& msg)
 {
 	if (!rawMessages) {
-		msg->writeMessageLength();
+		msg->writeMessageLength(compressionEnabled && compress(*msg));
 
 		if (encryptionEnabled) {
 			XTEA_encrypt(*msg);
@@ -51,14 +104,38 @@ OutputMessage_ptr Protocol::getOutputBuffer(int32_t size)
 {
 	//dispatcher thread
 	if (!outputBuffer) {
-		outputBuffer = OutputMessagePool::getOutputMessage();
+		outputBuffer = OutputMessagePool::getOutputMessage(size);
 	} else if ((outputBuffer->getLength() + size) > NetworkMessage::MAX_PROTOCOL_BODY_LENGTH) {
 		send(outputBuffer);
-		outputBuffer = OutputMessagePool::getOutputMessage();
+		outputBuffer = OutputMessagePool::getOutputMessage(size);
 	}
 	return outputBuffer;
 }
 
+bool Protocol::compress(OutputMessage& msg)
+{
+	//network thread
+	const size_t inputSize = msg.getLength();
+	if (inputSize < static_cast<size_t>(g_config.getNumber(ConfigManager::PACKET_COMPRESSION_THRESHOLD))) {
+		return false;
+	}
+
+	static thread_local Deflater deflater;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	size_t outputSize;
+	bool compressed = deflater.deflate(msg.getOutputBuffer(), inputSize, outputSize) && outputSize < inputSize;
+	if (compressed) {
+		msg.setBody(deflater.getBuffer(), outputSize);
+		compressionInputBytes += inputSize;
+		compressionOutputBytes += outputSize;
+	}
+
+	compressionTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	return compressed;
+}
+
 void Protocol::XTEA_encrypt(OutputMessage& msg) const
 {
 	const uint32_t delta = 0x61C88647;
@@ -145,6 +222,19 @@ bool Protocol::RSA_decrypt(NetworkMessage& msg)
 	return msg.getByte() == 0;
 }
 
+size_t Protocol::getMemoryUsage() const
+{
+	size_t usage = 0;
+	if (auto connection = getConnection()) {
+		usage += connection->getMemoryUsage();
+	}
+
+	if (outputBuffer) {
+		usage += sizeof(OutputMessage) + outputBuffer->getCapacity();
+	}
+	return usage;
+}
+
 uint32_t Protocol::getIP() const
 {
 	if (auto connection = getConnection()) {
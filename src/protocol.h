@@ -21,6 +21,8 @@
 #ifndef FS_PROTOCOL_H_D71405071ACF4137A4B1203899DE80E1
 #define FS_PROTOCOL_H_D71405071ACF4137A4B1203899DE80E1
 
+#include <atomic>
+
 #include "connection.h"
 
 class Protocol : public std::enable_shared_from_this<Protocol>
@@ -35,7 +37,7 @@ class Protocol : public std::enable_shared_from_this<Protocol>
 
 		virtual void parsePacket(NetworkMessage&) {}
 
-		virtual void onSendMessage(const OutputMessage_ptr& msg) const;
+		virtual void onSendMessage(const OutputMessage_ptr& msg);
 		void onRecvMessage(NetworkMessage& msg);
 		virtual void onRecvFirstMessage(NetworkMessage& msg) = 0;
 		virtual void onConnect() {}
@@ -49,6 +51,20 @@ class Protocol : public std::enable_shared_from_this<Protocol>
 		}
 
 		uint32_t getIP() const;
+		size_t getMemoryUsage() const;
+
+		bool isCompressionEnabled() const {
+			return compressionEnabled;
+		}
+		uint64_t getCompressionInputBytes() const {
+			return compressionInputBytes;
+		}
+		uint64_t getCompressionOutputBytes() const {
+			return compressionOutputBytes;
+		}
+		uint64_t getCompressionTime() const {
+			return compressionTime;
+		}
 
 		//Use this function for autosend messages only
 		OutputMessage_ptr getOutputBuffer(int32_t size);
@@ -78,6 +94,9 @@ class Protocol : public std::enable_shared_from_this<Protocol>
 		void disableChecksum() {
 			checksumEnabled = false;
 		}
+		void enableCompression() {
+			compressionEnabled = true;
+		}
 
 		static bool RSA_decrypt(NetworkMessage& msg);
 
@@ -90,6 +109,7 @@ class Protocol : public std::enable_shared_from_this<Protocol>
 	private:
 		void XTEA_encrypt(OutputMessage& msg) const;
 		bool XTEA_decrypt(NetworkMessage& msg) const;
+		bool compress(OutputMessage& msg);
 
 		friend class Connection;
 
@@ -97,9 +117,16 @@ class Protocol : public std::enable_shared_from_this<Protocol>
 
 		const ConnectionWeak_ptr connection;
 		uint32_t key[4] = {};
+
+		// written by the network thread, read by scripts
+		std::atomic<uint64_t> compressionInputBytes {0};
+		std::atomic<uint64_t> compressionOutputBytes {0};
+		std::atomic<uint64_t> compressionTime {0};
+
 		bool encryptionEnabled = false;
 		bool checksumEnabled = true;
 		bool rawMessages = false;
+		bool compressionEnabled = false;
 };
 
 #endif
@@ -21,6 +21,7 @@
 #include "otpch.h"
 
 #include <boost/range/adaptor/reversed.hpp>
+#include <unordered_set>
 
 #include "protocolgame.h"
 
@@ -35,6 +36,7 @@
 #include "iomarket.h"
 #include "waitlist.h"
 #include "ban.h"
+#include "databaseworkers.h"
 #include "scheduler.h"
 #include "moves.h"
 
@@ -57,63 +59,100 @@ void ProtocolGame::release()
 	Protocol::release();
 }
 
-void ProtocolGame::login(const std::string& name, uint32_t accountId, OperatingSystem_t operatingSystem)
+void ProtocolGame::authenticate(const std::string& accountName, const std::string& password, std::string token, uint32_t tokenTime, std::string characterName, OperatingSystem_t operatingSystem)
 {
-	//dispatcher thread
-	Player* foundPlayer = g_game.getPlayerByName(name);
-	if (!foundPlayer || g_config.getBoolean(ConfigManager::ALLOW_CLONES)) {
-		player = new Player(getThis());
-		player->setName(name);
+	//database worker thread
+	BanInfo banInfo;
+	if (IOBan::isIpBanned(getIP(), banInfo)) {
+		if (banInfo.reason.empty()) {
+			banInfo.reason = "(none)";
+		}
 
-		player->incrementReferenceCounter();
-		player->setID();
+		std::ostringstream ss;
+		ss << "Your IP has been banned until " << formatDateShort(banInfo.expiresAt) << " by " << banInfo.bannedBy << ".\n\nReason specified:\n" << banInfo.reason;
+		disconnectClient(ss.str());
+		return;
+	}
 
-		if (!IOLoginData::preloadPlayer(player, name)) {
-			disconnectClient("Your character could not be loaded.");
-			return;
+	uint32_t accountId = IOLoginData::gameworldAuthentication(accountName, password, characterName, token, tokenTime);
+	if (accountId == 0) {
+		disconnectClient("Account name or password is not correct.");
+		return;
+	}
+
+	// the player stays out of the game state until the dispatcher places it
+	Player* loadingPlayer = new Player(getThis());
+	loadingPlayer->setName(characterName);
+	loadingPlayer->incrementReferenceCounter();
+
+	if (!IOLoginData::preloadPlayer(loadingPlayer, characterName)) {
+		disconnectClient("Your character could not be loaded.");
+		loadingPlayer->decrementReferenceCounter();
+		return;
+	}
+
+	if (IOBan::isPlayerNamelocked(loadingPlayer->getGUID())) {
+		disconnectClient("Your character has been namelocked.");
+		loadingPlayer->decrementReferenceCounter();
+		return;
+	}
+
+	if (!loadingPlayer->hasFlag(PlayerFlag_CannotBeBanned) && IOBan::isAccountBanned(accountId, banInfo)) {
+		if (banInfo.reason.empty()) {
+			banInfo.reason = "(none)";
 		}
 
-		if (IOBan::isPlayerNamelocked(player->getGUID())) {
-			disconnectClient("Your character has been namelocked.");
-			return;
+		std::ostringstream ss;
+		if (banInfo.expiresAt > 0) {
+			ss << "Your account has been banned until " << formatDateShort(banInfo.expiresAt) << " by " << banInfo.bannedBy << ".\n\nReason specified:\n" << banInfo.reason;
+		} else {
+			ss << "Your account has been permanently banned by " << banInfo.bannedBy << ".\n\nReason specified:\n" << banInfo.reason;
 		}
+		disconnectClient(ss.str());
+		loadingPlayer->decrementReferenceCounter();
+		return;
+	}
 
-		if (g_game.getGameState() == GAME_STATE_CLOSING && !player->hasFlag(PlayerFlag_CanAlwaysLogin)) {
+	g_dispatcher.addTask(createTask(std::bind(&ProtocolGame::login, getThis(), loadingPlayer, operatingSystem)));
+}
+
+void ProtocolGame::login(Player* loadingPlayer, OperatingSystem_t operatingSystem)
+{
+	//dispatcher thread
+	if (isConnectionExpired()) {
+		loadingPlayer->decrementReferenceCounter();
+		return;
+	}
+
+	Player* foundPlayer = g_game.getPlayerByName(loadingPlayer->getName());
+	if (!foundPlayer || g_config.getBoolean(ConfigManager::ALLOW_CLONES)) {
+		if (g_game.getGameState() == GAME_STATE_CLOSING && !loadingPlayer->hasFlag(PlayerFlag_CanAlwaysLogin)) {
 			disconnectClient("The game is just going down.\nPlease try again later.");
+			loadingPlayer->decrementReferenceCounter();
 			return;
 		}
 
-		if (g_game.getGameState() == GAME_STATE_CLOSED && !player->hasFlag(PlayerFlag_CanAlwaysLogin)) {
+		if (g_game.getGameState() == GAME_STATE_CLOSED && !loadingPlayer->hasFlag(PlayerFlag_CanAlwaysLogin)) {
 			disconnectClient("Server is currently closed.\nPlease try again later.");
+			loadingPlayer->decrementReferenceCounter();
 			return;
 		}
 
-		if (g_config.getBoolean(ConfigManager::ONE_PLAYER_ON_ACCOUNT) && player->getAccountType() < ACCOUNT_TYPE_GAMEMASTER && g_game.getPlayerByAccount(player->getAccount())) {
+		if (g_config.getBoolean(ConfigManager::ONE_PLAYER_ON_ACCOUNT) && loadingPlayer->getAccountType() < ACCOUNT_TYPE_GAMEMASTER && g_game.getPlayerByAccount(loadingPlayer->getAccount())) {
 			disconnectClient("You may only login with one character\nof your account at the same time.");
+			loadingPlayer->decrementReferenceCounter();
 			return;
 		}
 
-		if (!player->hasFlag(PlayerFlag_CannotBeBanned)) {
-			BanInfo banInfo;
-			if (IOBan::isAccountBanned(accountId, banInfo)) {
-				if (banInfo.reason.empty()) {
-					banInfo.reason = "(none)";
-				}
-
-				std::ostringstream ss;
-				if (banInfo.expiresAt > 0) {
-					ss << "Your account has been banned until " << formatDateShort(banInfo.expiresAt) << " by " << banInfo.bannedBy << ".\n\nReason specified:\n" << banInfo.reason;
-				} else {
-					ss << "Your account has been permanently banned by " << banInfo.bannedBy << ".\n\nReason specified:\n" << banInfo.reason;
-				}
-				disconnectClient(ss.str());
-				return;
-			}
+		if (!g_config.getBoolean(ConfigManager::ALLOW_CLONES) && IOLoginData::isLoadingPlayer(loadingPlayer->getGUID())) {
+			disconnectClient("You are already logged in.");
+			loadingPlayer->decrementReferenceCounter();
+			return;
 		}
 
 		WaitingList& waitingList = WaitingList::getInstance();
-		if (!waitingList.clientLogin(player)) {
-			uint32_t currentSlot = waitingList.getClientSlot(player);
+		if (!waitingList.clientLogin(loadingPlayer)) {
+			uint32_t currentSlot = waitingList.getClientSlot(loadingPlayer);
 			uint32_t retryTime = WaitingList::getTime(currentSlot);
 			std::ostringstream ss;
 
@@ -126,31 +165,15 @@ void ProtocolGame::login(const std::string& name, uint32_t accountId, OperatingS
 			output->addByte(retryTime);
 			send(output);
 			disconnect();
+			loadingPlayer->decrementReferenceCounter();
 			return;
 		}
 
-		if (!IOLoginData::loadPlayerById(player, player->getGUID())) {
-			disconnectClient("Your character could not be loaded.");
-			return;
-		}
-
-		player->setOperatingSystem(operatingSystem);
-
-		if (!g_game.placeCreature(player, player->getLoginPosition())) {
-			if (!g_game.placeCreature(player, player->getPokemonCenterPosition(), false, true)) {
-				disconnectClient("Pokemon Center position is wrong. Contact the administrator.");
-				return;
-			}
-		}
-
-		if (operatingSystem >= CLIENTOS_OTCLIENT_LINUX) {
-			player->registerCreatureEvent("ExtendedOpcode");
-		}
-
-		player->lastIP = player->getIP();
-		player->lastLoginSaved = std::max<time_t>(time(nullptr), player->lastLoginSaved + 1);
-		acceptPackets = true;
+		IOLoginData::addLoadingPlayer(loadingPlayer->getGUID());
+		g_databaseWorkers.addTask(std::bind(&ProtocolGame::loadPlayer, getThis(), loadingPlayer, operatingSystem));
 	} else {
+		loadingPlayer->decrementReferenceCounter();
+
 		if (eventConnect != 0 || !g_config.getBoolean(ConfigManager::REPLACE_KICK_ON_LOGIN)) {
 			//Already trying to connect
 			disconnectClient("You are already logged in.");
@@ -165,7 +188,63 @@ void ProtocolGame::login(const std::string& name, uint32_t accountId, OperatingS
 		} else {
 			connect(foundPlayer->getID(), operatingSystem);
 		}
+		OutputMessagePool::getInstance().addProtocolToAutosend(shared_from_this());
+	}
+}
+
+void ProtocolGame::loadPlayer(Player* loadingPlayer, OperatingSystem_t operatingSystem)
+{
+	//database worker thread
+	bool loaded = IOLoginData::loadPlayerById(loadingPlayer, loadingPlayer->getGUID(), true);
+	g_dispatcher.addTask(createTask(std::bind(&ProtocolGame::placePlayer, getThis(), loadingPlayer, loaded, operatingSystem)));
+}
+
+void ProtocolGame::placePlayer(Player* loadingPlayer, bool loaded, OperatingSystem_t operatingSystem)
+{
+	//dispatcher thread
+	IOLoginData::removeLoadingPlayer(loadingPlayer->getGUID());
+
+	if (loaded) {
+		IOLoginData::bindPlayerGuild(loadingPlayer);
+	}
+
+	if (isConnectionExpired()) {
+		loadingPlayer->decrementReferenceCounter();
+		return;
+	}
+
+	if (!loaded) {
+		disconnectClient("Your character could not be loaded.");
+		loadingPlayer->decrementReferenceCounter();
+		return;
+	}
+
+	// another character of the account may have logged in while this one was loading
+	if (g_config.getBoolean(ConfigManager::ONE_PLAYER_ON_ACCOUNT) && loadingPlayer->getAccountType() < ACCOUNT_TYPE_GAMEMASTER && g_game.getPlayerByAccount(loadingPlayer->getAccount())) {
+		disconnectClient("You may only login with one character\nof your account at the same time.");
+		loadingPlayer->decrementReferenceCounter();
+		return;
+	}
+
+	player = loadingPlayer;
+	player->setID();
+	player->setOperatingSystem(operatingSystem);
+
+	if (!g_game.placeCreature(player, player->getLoginPosition())) {
+		if (!g_game.placeCreature(player, player->getPokemonCenterPosition(), false, true)) {
+			disconnectClient("Pokemon Center position is wrong. Contact the administrator.");
+			return;
+		}
+	}
+
+	if (operatingSystem >= CLIENTOS_OTCLIENT_LINUX) {
+		player->registerCreatureEvent("ExtendedOpcode");
 	}
+
+	player->lastIP = player->getIP();
+	player->lastLoginSaved = std::max<time_t>(time(nullptr), player->lastLoginSaved + 1);
+	acceptPackets = true;
+
 	OutputMessagePool::getInstance().addProtocolToAutosend(shared_from_this());
 }
 
@@ -196,6 +275,8 @@ void ProtocolGame::connect(uint32_t playerId, OperatingSystem_t operatingSystem)
 	player->client = getThis();
 	sendAddCreature(player, player->getPosition(), 0, false);
 	player->lastIP = player->getIP();
+	// still the same session, keep the time spent online so far
+	player->savedOnlineTime += std::max<time_t>(0, time(nullptr) - player->lastLoginSaved);
 	player->lastLoginSaved = std::max<time_t>(time(nullptr), player->lastLoginSaved + 1);
 	acceptPackets = true;
 }
@@ -327,25 +408,7 @@ void ProtocolGame::onRecvFirstMessage(NetworkMessage& msg)
 		return;
 	}
 
-	BanInfo banInfo;
-	if (IOBan::isIpBanned(getIP(), banInfo)) {
-		if (banInfo.reason.empty()) {
-			banInfo.reason = "(none)";
-		}
-
-		std::ostringstream ss;
-		ss << "Your IP has been banned until " << formatDateShort(banInfo.expiresAt) << " by " << banInfo.bannedBy << ".\n\nReason specified:\n" << banInfo.reason;
-		disconnectClient(ss.str());
-		return;
-	}
-
-	uint32_t accountId = IOLoginData::gameworldAuthentication(accountName, password, characterName, token, tokenTime);
-	if (accountId == 0) {
-		disconnectClient("Account name or password is not correct.");
-		return;
-	}
-
-	g_dispatcher.addTask(createTask(std::bind(&ProtocolGame::login, getThis(), characterName, accountId, operatingSystem)));
+	g_databaseWorkers.addTask(std::bind(&ProtocolGame::authenticate, getThis(), accountName, password, token, tokenTime, characterName, operatingSystem));
 }
 
 void ProtocolGame::onConnect()
@@ -391,6 +454,46 @@ void ProtocolGame::writeToOutputBuffer(const NetworkMessage& msg)
 	out->append(msg);
 }
 
+bool ProtocolGame::consumePacketTokens(uint8_t opcode)
+{
+	//network thread
+	switch (opcode) {
+		// a throttled client must still be able to leave and keep its ping alive
+		case 0x0F: // leave
+		case 0x14: // logout
+		case 0x1D: // ping back
+		case 0x1E: // ping
+			return true;
+
+		default:
+			break;
+	}
+
+	const int64_t rate = g_config.getNumber(ConfigManager::MAX_PACKETS_PER_SECOND);
+	const int64_t now = OTSYS_TIME();
+
+	packetTokens = std::min<int64_t>(rate * 2000, packetTokens + (now - lastPacketRefill) * rate);
+	lastPacketRefill = now;
+
+	const int64_t cost = g_config.getPacketCost(opcode) * 1000;
+	if (packetTokens >= cost) {
+		packetTokens -= cost;
+		return true;
+	}
+
+	// dropping a few packets of a burst is fine, a client that keeps flooding is not
+	if (now - packetDropWindow >= 1000) {
+		packetDropWindow = now;
+		droppedPackets = 0;
+	}
+
+	if (++droppedPackets > rate) {
+		std::cout << convertIPToString(getIP()) << " disconnected for exceeding packet per second limit." << std::endl;
+		disconnect();
+	}
+	return false;
+}
+
 void ProtocolGame::parsePacket(NetworkMessage& msg)
 {
 	if (!acceptPackets || g_game.getGameState() == GAME_STATE_SHUTDOWN || msg.getLength() <= 0) {
@@ -398,6 +501,9 @@ void ProtocolGame::parsePacket(NetworkMessage& msg)
 	}
 
 	uint8_t recvbyte = msg.getByte();
+	if (!consumePacketTokens(recvbyte)) {
+		return;
+	}
 
 	if (!player) {
 		if (recvbyte == 0x0F) {
@@ -516,29 +622,28 @@ void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
 {
 	msg.add<uint16_t>(0x00); //environmental effects
 
-	int32_t count;
-	Item* ground = tile->getGround();
-	if (ground) {
-		msg.addItem(ground);
-		count = 1;
-	} else {
-		count = 0;
-	}
+	// items are copied from the tile's encoded cache, only creatures depend on the viewer
+	const TileItemCache& cache = tile->getItemCache();
+	bool isPlayerTile = tile->getPosition() == player->getPosition();
 
-	const TileItemVector* items = tile->getItemList();
-	if (items) {
-		for (auto it = items->getBeginTopItem(), end = items->getEndTopItem(); it != end; ++it) {
-			msg.addItem(*it);
+	int32_t count = 0;
+	uint8_t topCount = 0;
+	while (topCount < cache.topCount) {
+		++topCount;
 
-			count++;
-			if (count == 9 && tile->getPosition() == player->getPosition()) {
-				break;
-			} else if (count == 10) {
-				return;
-			}
+		if (++count == 10 || (count == 9 && isPlayerTile)) {
+			break;
 		}
 	}
 
+	if (topCount != 0) {
+		msg.addBytes(cache.topItems.data(), cache.topEnd[topCount - 1]);
+	}
+
+	if (count == 10) {
+		return;
+	}
+
 	const CreatureVector* creatures = tile->getCreatures();
 	if (creatures) {
 		bool playerAdded = false;
@@ -547,7 +652,7 @@ void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
 				continue;
 			}
 
-			if (tile->getPosition() == player->getPosition() && count == 9 && !playerAdded) {
+			if (isPlayerTile && count == 9 && !playerAdded) {
 				creature = player;
 			}
 
@@ -566,14 +671,9 @@ void ProtocolGame::GetTileDescription(const Tile* tile, NetworkMessage& msg)
 		}
 	}
 
-	if (items) {
-		for (auto it = items->getBeginDownItem(), end = items->getEndDownItem(); it != end; ++it) {
-			msg.addItem(*it);
-
-			if (++count == 10) {
-				return;
-			}
-		}
+	uint8_t downCount = std::min<int32_t>(cache.downCount, 10 - count);
+	if (downCount != 0) {
+		msg.addBytes(cache.downItems.data(), cache.downEnd[downCount - 1]);
 	}
 }
 
@@ -628,35 +728,11 @@ void ProtocolGame::GetFloorDescription(NetworkMessage& msg, int32_t x, int32_t y
 
 void ProtocolGame::checkCreatureAsKnown(uint32_t id, bool& known, uint32_t& removedKnown)
 {
-	auto result = knownCreatureSet.insert(id);
-	if (!result.second) {
-		known = true;
-		return;
-	}
-
-	known = false;
-
-	if (knownCreatureSet.size() > 1300) {
-		// Look for a creature to remove
-		for (auto it = knownCreatureSet.begin(), end = knownCreatureSet.end(); it != end; ++it) {
-			Creature* creature = g_game.getCreatureByID(*it);
-			if (!canSee(creature)) {
-				removedKnown = *it;
-				knownCreatureSet.erase(it);
-				return;
-			}
-		}
-
-		// Bad situation. Let's just remove anyone.
-		auto it = knownCreatureSet.begin();
-		if (*it == id) {
-			++it;
-		}
-
-		removedKnown = *it;
-		knownCreatureSet.erase(it);
-	} else {
-		removedKnown = 0;
+	known = knownCreatures.touch(id);
+	if (!known) {
+		removedKnown = knownCreatures.insert(id, [this](uint32_t knownId) {
+			return canSee(g_game.getCreatureByID(knownId));
+		});
 	}
 }
 
@@ -1188,6 +1264,7 @@ void ProtocolGame::sendCreatureOutfit(const Creature* creature, const Outfit_t&
 	if (!canSee(creature)) {
 		return;
 	}
+	knownCreatures.touch(creature->getID());
 
 	NetworkMessage msg;
 	msg.addByte(0x8E);
@@ -1201,6 +1278,7 @@ void ProtocolGame::sendCreatureName(const Creature* creature, const std::string&
 	if (!canSee(creature)) {
 		return;
 	}
+	knownCreatures.touch(creature->getID());
 
 	NetworkMessage msg;
 	msg.addByte(0x62);
@@ -1214,6 +1292,7 @@ void ProtocolGame::sendCreatureLight(const Creature* creature)
 	if (!canSee(creature)) {
 		return;
 	}
+	knownCreatures.touch(creature->getID());
 
 	NetworkMessage msg;
 	AddCreatureLight(msg, creature);
@@ -1232,6 +1311,7 @@ void ProtocolGame::sendCreatureWalkthrough(const Creature* creature, bool walkth
 	if (!canSee(creature)) {
 		return;
 	}
+	knownCreatures.touch(creature->getID());
 
 	NetworkMessage msg;
 	msg.addByte(0x92);
@@ -1245,6 +1325,7 @@ void ProtocolGame::sendCreatureShield(const Creature* creature)
 	if (!canSee(creature)) {
 		return;
 	}
+	knownCreatures.touch(creature->getID());
 
 	NetworkMessage msg;
 	msg.addByte(0x91);
@@ -1258,6 +1339,7 @@ void ProtocolGame::sendCreatureGender(const Creature* creature)
 	if (!canSee(creature)) {
 		return;
 	}
+	knownCreatures.touch(creature->getID());
 
 	NetworkMessage msg;
 	msg.addByte(0x90);
@@ -1289,6 +1371,7 @@ void ProtocolGame::sendCreatureSquare(const Creature* creature, SquareColor_t co
 	if (!canSee(creature)) {
 		return;
 	}
+	knownCreatures.touch(creature->getID());
 
 	NetworkMessage msg;
 	msg.addByte(0x93);
@@ -2080,6 +2163,7 @@ void ProtocolGame::sendCreatureTurn(const Creature* creature, uint32_t stackPos)
 	if (!canSee(creature)) {
 		return;
 	}
+	knownCreatures.touch(creature->getID());
 
 	NetworkMessage msg;
 	msg.addByte(0x6B);
@@ -2270,6 +2354,8 @@ void ProtocolGame::sendAnimatedText(const Position& pos, uint8_t color, const st
 
 void ProtocolGame::sendCreatureHealth(const Creature* creature)
 {
+	knownCreatures.touch(creature->getID());
+
 	NetworkMessage msg;
 	msg.addByte(0x8C);
 	msg.add<uint32_t>(creature->getID());
@@ -2514,12 +2600,21 @@ void ProtocolGame::sendMoveCreature(const Creature* creature, const Position& ne
 				GetMapDescription(newPos.x - 8, newPos.y - 6, newPos.z, 1, 14, msg);
 			}
 			writeToOutputBuffer(msg);
+
+			// the new rows were described above, those still in view were seen again
+			SpectatorHashSet spectators;
+			g_game.map.getSpectators(spectators, newPos, true);
+			for (Creature* spectator : spectators) {
+				knownCreatures.touch(spectator->getID());
+			}
 		}
 	} else if (canSee(oldPos) && canSee(creature->getPosition())) {
 		if (teleport || (oldPos.z == 7 && newPos.z >= 8) || oldStackPos >= 10) {
 			sendRemoveTileThing(oldPos, oldStackPos);
 			sendAddCreature(creature, newPos, newStackPos, false);
 		} else {
+			knownCreatures.touch(creature->getID());
+
 			NetworkMessage msg;
 			msg.addByte(0x6D);
 			msg.addPosition(oldPos);
@@ -3112,11 +3207,32 @@ void ProtocolGame::AddShopItem(NetworkMessage& msg, const ShopInfo& item)
 	msg.add<uint32_t>(item.sellPrice);
 }
 
+void ProtocolGame::parseCompressionRequest()
+{
+	if (isCompressionEnabled() || !g_config.getBoolean(ConfigManager::ALLOW_PACKET_COMPRESSION)) {
+		return;
+	}
+
+	// the acknowledgement may already go out compressed, the client tells them apart by the length flag
+	enableCompression();
+
+	auto output = OutputMessagePool::getOutputMessage();
+	output->addByte(0x32);
+	output->addByte(EXTENDED_OPCODE_COMPRESSION);
+	output->addString(std::to_string(g_config.getNumber(ConfigManager::PACKET_COMPRESSION_THRESHOLD)));
+	send(output);
+}
+
 void ProtocolGame::parseExtendedOpcode(NetworkMessage& msg)
 {
 	uint8_t opcode = msg.getByte();
 	const std::string& buffer = msg.getString();
 
+	if (opcode == EXTENDED_OPCODE_COMPRESSION) {
+		parseCompressionRequest();
+		return;
+	}
+
 	// process additional opcodes via lua script event
 	addGameTask(&Game::parsePlayerExtendedOpcode, player->getID(), opcode, buffer);
 }
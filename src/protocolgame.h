@@ -24,6 +24,7 @@
 #include "protocol.h"
 #include "chat.h"
 #include "creature.h"
+#include "knowncreatures.h"
 #include "tasks.h"
 
 class NetworkMessage;
@@ -67,7 +68,6 @@ class ProtocolGame final : public Protocol
 
 		explicit ProtocolGame(Connection_ptr connection) : Protocol(connection) {}
 
-		void login(const std::string& name, uint32_t accountId, OperatingSystem_t operatingSystem);
 		void logout(bool displayEffect, bool forced);
 
 		uint16_t getVersion() const {
@@ -78,6 +78,11 @@ class ProtocolGame final : public Protocol
 		ProtocolGame_ptr getThis() {
 			return std::static_pointer_cast<ProtocolGame>(shared_from_this());
 		}
+		// login pipeline, database work runs on g_databaseWorkers
+		void authenticate(const std::string& accountName, const std::string& password, std::string token, uint32_t tokenTime, std::string characterName, OperatingSystem_t operatingSystem);
+		void login(Player* loadingPlayer, OperatingSystem_t operatingSystem);
+		void loadPlayer(Player* loadingPlayer, OperatingSystem_t operatingSystem);
+		void placePlayer(Player* loadingPlayer, bool loaded, OperatingSystem_t operatingSystem);
 		void connect(uint32_t playerId, OperatingSystem_t operatingSystem);
 		void disconnectClient(const std::string& message) const;
 		void writeToOutputBuffer(const NetworkMessage& msg);
@@ -90,6 +95,8 @@ class ProtocolGame final : public Protocol
 		bool canSee(const Creature*) const;
 		bool canSee(const Position& pos) const;
 
+		bool consumePacketTokens(uint8_t opcode);
+
 		// we have all the parse methods
 		void parsePacket(NetworkMessage& msg) override;
 		void onRecvFirstMessage(NetworkMessage& msg) override;
@@ -306,6 +313,7 @@ class ProtocolGame final : public Protocol
 
 		//otclient
 		void parseExtendedOpcode(NetworkMessage& msg);
+		void parseCompressionRequest();
 
 		friend class Player;
 
@@ -320,9 +328,18 @@ class ProtocolGame final : public Protocol
 			g_dispatcher.addTask(createTask(delay, std::bind(function, &g_game, std::forward<Args>(args)...)));
 		}
 
-		std::unordered_set<uint32_t> knownCreatureSet;
+		// moved to the front whenever they are described or updated, the
+		// eviction passes over those still in view
+		KnownCreatures knownCreatures;
 		Player* player = nullptr;
 
+		// token bucket of the opcode costs, in thousandths of a token; the
+		// connection limits the plain packet rate before any of them
+		int64_t packetTokens = 0;
+		int64_t lastPacketRefill = 0;
+		int64_t packetDropWindow = 0;
+		uint32_t droppedPackets = 0;
+
 		uint32_t eventConnect = 0;
 		uint32_t challengeTimestamp = 0;
 		uint16_t version = CLIENT_VERSION_MIN;
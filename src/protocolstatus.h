@@ -45,7 +45,9 @@ class ProtocolStatus final : public Protocol
 		static const uint64_t start;
 
 	private:
+		// first messages are parsed on the handshake workers
 		static std::map<uint32_t, int64_t> ipConnectMap;
+		static std::mutex ipConnectLock;
 };
 
 #endif
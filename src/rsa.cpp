@@ -22,23 +22,59 @@
 
 #include "rsa.h"
 
+namespace {
+
+// decryption temporaries, allocated once per thread instead of once per call
+struct DecryptContext {
+	DecryptContext() {
+		mpz_init2(c, 1024);
+		mpz_init2(m1, 1024);
+		mpz_init2(m2, 1024);
+		mpz_init2(h, 2048);
+	}
+	~DecryptContext() {
+		mpz_clear(c);
+		mpz_clear(m1);
+		mpz_clear(m2);
+		mpz_clear(h);
+	}
+
+	// non-copyable
+	DecryptContext(const DecryptContext&) = delete;
+	DecryptContext& operator=(const DecryptContext&) = delete;
+
+	mpz_t c, m1, m2, h;
+};
+
+thread_local DecryptContext decryptContext;
+
+}
+
 RSA::RSA()
 {
 	mpz_init(n);
 	mpz_init2(d, 1024);
+	mpz_init2(p, 512);
+	mpz_init2(q, 512);
+	mpz_init2(dp, 512);
+	mpz_init2(dq, 512);
+	mpz_init2(qInv, 512);
 }
 
 RSA::~RSA()
 {
 	mpz_clear(n);
 	mpz_clear(d);
+	mpz_clear(p);
+	mpz_clear(q);
+	mpz_clear(dp);
+	mpz_clear(dq);
+	mpz_clear(qInv);
 }
 
 void RSA::setKey(const char* pString, const char* qString)
 {
-	mpz_t p, q, e;
-	mpz_init2(p, 1024);
-	mpz_init2(q, 1024);
+	mpz_t e;
 	mpz_init(e);
 
 	mpz_set_str(p, pString, 10);
@@ -64,30 +100,56 @@ void RSA::setKey(const char* pString, const char* qString)
 	// d = e^-1 mod (p - 1)(q - 1)
 	mpz_invert(d, e, pq_1);
 
+	// dp = d mod (p - 1), dq = d mod (q - 1), qInv = q^-1 mod p
+	mpz_mod(dp, d, p_1);
+	mpz_mod(dq, d, q_1);
+	mpz_invert(qInv, q, p);
+
 	mpz_clear(p_1);
 	mpz_clear(q_1);
 	mpz_clear(pq_1);
 
-	mpz_clear(p);
-	mpz_clear(q);
 	mpz_clear(e);
 }
 
 void RSA::decrypt(char* msg) const
 {
-	mpz_t c, m;
-	mpz_init2(c, 1024);
-	mpz_init2(m, 1024);
+	DecryptContext& ctx = decryptContext;
+
+	mpz_import(ctx.c, 128, 1, 1, 0, 0, msg);
 
-	mpz_import(c, 128, 1, 1, 0, 0, msg);
+	// m1 = c^dp mod p, m2 = c^dq mod q
+	mpz_powm(ctx.m1, ctx.c, dp, p);
+	mpz_powm(ctx.m2, ctx.c, dq, q);
 
-	// m = c^d mod n
-	mpz_powm(m, c, d, n);
+	// h = qInv * (m1 - m2) mod p
+	mpz_sub(ctx.h, ctx.m1, ctx.m2);
+	mpz_mul(ctx.h, ctx.h, qInv);
+	mpz_mod(ctx.h, ctx.h, p);
 
-	size_t count = (mpz_sizeinbase(m, 2) + 7) / 8;
+	// m = m2 + h * q
+	mpz_mul(ctx.h, ctx.h, q);
+	mpz_add(ctx.m1, ctx.m2, ctx.h);
+
+	size_t count = (mpz_sizeinbase(ctx.m1, 2) + 7) / 8;
 	memset(msg, 0, 128 - count);
-	mpz_export(msg + (128 - count), nullptr, 1, 1, 0, 0, m);
+	mpz_export(msg + (128 - count), nullptr, 1, 1, 0, 0, ctx.m1);
+}
 
-	mpz_clear(c);
-	mpz_clear(m);
+uint32_t RSA::getDecryptionsPerSecond() const
+{
+	static constexpr int32_t iterations = 200;
+
+	char block[128];
+	for (size_t i = 0; i < sizeof(block); ++i) {
+		block[i] = static_cast<char>(i * 31 + 7);
+	}
+	block[0] = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int32_t i = 0; i < iterations; ++i) {
+		decrypt(block);
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	return static_cast<uint32_t>(iterations * 1000000LL / std::max<int64_t>(1, elapsed));
 }
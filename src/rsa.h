@@ -36,9 +36,15 @@ class RSA
 		void setKey(const char* pString, const char* qString);
 		void decrypt(char* msg) const;
 
+		// measures decrypt() on the calling thread
+		uint32_t getDecryptionsPerSecond() const;
+
 	private:
 		//use only GMP
 		mpz_t n, d;
+
+		// Chinese Remainder Theorem key parts
+		mpz_t p, q, dp, dq, qInv;
 };
 
 #endif
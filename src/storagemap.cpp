@@ -0,0 +1,97 @@
+/**
+ * The Ruby Server - a free and open-source Pokémon MMORPG server emulator
+ * Copyright (C) 2018  Mark Samman (TFS) <mark.samman@gmail.com>
+ *                     Leandro Matheus <kesuhige@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "otpch.h"
+
+#include "storagemap.h"
+
+static bool keyLess(const std::pair<uint32_t, int32_t>& entry, uint32_t key)
+{
+	return entry.first < key;
+}
+
+bool StorageMap::get(uint32_t key, int32_t& value) const
+{
+	auto it = std::lower_bound(values.begin(), values.end(), key, keyLess);
+	if (it == values.end() || it->first != key) {
+		value = -1;
+		return false;
+	}
+
+	value = it->second;
+	return true;
+}
+
+void StorageMap::set(uint32_t key, int32_t value)
+{
+	auto it = std::lower_bound(values.begin(), values.end(), key, keyLess);
+	if (it == values.end() || it->first != key) {
+		values.emplace(it, key, value);
+	} else if (it->second != value) {
+		it->second = value;
+	} else {
+		return;
+	}
+	setChanged(key);
+}
+
+void StorageMap::erase(uint32_t key)
+{
+	auto it = std::lower_bound(values.begin(), values.end(), key, keyLess);
+	if (it == values.end() || it->first != key) {
+		return;
+	}
+
+	values.erase(it);
+	setChanged(key);
+}
+
+void StorageMap::erase(uint32_t first, uint32_t last)
+{
+	auto begin = std::lower_bound(values.begin(), values.end(), first, keyLess);
+	auto end = begin;
+	while (end != values.end() && end->first <= last) {
+		setChanged(end->first);
+		++end;
+	}
+	values.erase(begin, end);
+}
+
+uint64_t StorageMap::getChanges(std::vector<uint32_t>& keys) const
+{
+	keys.reserve(changes.size());
+	for (const auto& it : changes) {
+		keys.push_back(it.first);
+	}
+	return lastChange;
+}
+
+void StorageMap::clearChanges(uint64_t stamp)
+{
+	// whatever changed again after the snapshot still has to be written
+	auto it = changes.begin();
+	while (it != changes.end()) {
+		if (it->second <= stamp) {
+			it = changes.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
@@ -0,0 +1,67 @@
+/**
+ * The Ruby Server - a free and open-source Pokémon MMORPG server emulator
+ * Copyright (C) 2018  Mark Samman (TFS) <mark.samman@gmail.com>
+ *                     Leandro Matheus <kesuhige@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FS_STORAGEMAP_H_2B7E4C1D9F6A4E0B8C3D5A7F1E9B2C64
+#define FS_STORAGEMAP_H_2B7E4C1D9F6A4E0B8C3D5A7F1E9B2C64
+
+// Storage values of a player, sorted by key in one vector. Remembers the
+// keys that changed until a save holding them got written.
+class StorageMap
+{
+	public:
+		typedef std::vector<std::pair<uint32_t, int32_t>>::const_iterator const_iterator;
+
+		bool get(uint32_t key, int32_t& value) const;
+		void set(uint32_t key, int32_t value);
+		void erase(uint32_t key);
+		// every key from first to last
+		void erase(uint32_t first, uint32_t last);
+
+		size_t size() const {
+			return values.size();
+		}
+		const_iterator begin() const {
+			return values.begin();
+		}
+		const_iterator end() const {
+			return values.end();
+		}
+
+		bool hasChanges() const {
+			return !changes.empty();
+		}
+		// fills the keys changed since they were last written, the result goes to clearChanges once they are
+		uint64_t getChanges(std::vector<uint32_t>& keys) const;
+		void clearChanges(uint64_t stamp);
+		void clearChanges() {
+			changes.clear();
+		}
+
+	private:
+		void setChanged(uint32_t key) {
+			changes[key] = ++lastChange;
+		}
+
+		std::vector<std::pair<uint32_t, int32_t>> values;
+		std::unordered_map<uint32_t, uint64_t> changes; // key and the stamp of its last change
+		uint64_t lastChange = 0;
+};
+
+#endif
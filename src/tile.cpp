@@ -30,6 +30,7 @@
 #include "mailbox.h"
 #include "pokemon.h"
 #include "movement.h"
+#include "networkmessage.h"
 #include "teleport.h"
 #include "trashholder.h"
 #include "configmanager.h"
@@ -38,6 +39,50 @@ extern ConfigManager g_config;
 extern Game g_game;
 extern MoveEvents* g_moveEvents;
 
+namespace {
+
+// dispatcher thread, the item caches of all tiles; once all of them are taken
+// the next one is reused in clock order, skipping those described since the
+// last pass
+class TileItemCachePool
+{
+	public:
+		static constexpr size_t MAX_CACHES = 1 << 18;
+
+		TileItemCachePool() {
+			// the caches must not move, tiles point at them
+			caches.reserve(MAX_CACHES);
+		}
+
+		TileItemCache* acquire() {
+			TileItemCache* cache;
+			if (caches.size() < MAX_CACHES) {
+				caches.emplace_back();
+				cache = &caches.back();
+			} else {
+				while (caches[hand].used) {
+					caches[hand].used = false;
+					hand = (hand + 1) % MAX_CACHES;
+				}
+				cache = &caches[hand];
+				hand = (hand + 1) % MAX_CACHES;
+			}
+
+			cache->generation = ++lastGeneration;
+			cache->version = 0;
+			return cache;
+		}
+
+	private:
+		std::vector<TileItemCache> caches;
+		size_t hand = 0;
+		uint64_t lastGeneration = 0;
+};
+
+TileItemCachePool tileItemCachePool;
+
+}
+
 StaticTile real_nullptr_tile(0xFFFF, 0xFFFF, 0xFF);
 Tile& Tile::nullptr_tile = real_nullptr_tile;
 
@@ -373,8 +418,52 @@ Thing* Tile::getTopVisibleThing(const Creature* creature)
 	return ground;
 }
 
+const TileItemCache& Tile::getItemCache() const
+{
+	if (!itemCache || itemCache->generation != itemCacheGeneration) {
+		itemCache = tileItemCachePool.acquire();
+		itemCacheGeneration = itemCache->generation;
+	} else if (itemCache->version == itemVersion) {
+		itemCache->used = true;
+		return *itemCache;
+	}
+
+	TileItemCache& cache = *itemCache;
+	cache.used = true;
+	cache.version = itemVersion;
+	cache.topCount = 0;
+	cache.downCount = 0;
+
+	NetworkMessage msg;
+	if (ground) {
+		msg.addItem(ground);
+		cache.topEnd[cache.topCount++] = msg.getLength();
+	}
+
+	const TileItemVector* items = getItemList();
+	if (items) {
+		for (auto it = items->getBeginTopItem(), end = items->getEndTopItem(); it != end && cache.topCount < TileItemCache::MAX_ENTRIES; ++it) {
+			msg.addItem(*it);
+			cache.topEnd[cache.topCount++] = msg.getLength();
+		}
+	}
+	cache.topItems.assign(reinterpret_cast<const char*>(msg.getBuffer()) + NetworkMessage::INITIAL_BUFFER_POSITION, msg.getLength());
+
+	msg.reset();
+	if (items) {
+		for (auto it = items->getBeginDownItem(), end = items->getEndDownItem(); it != end && cache.downCount < TileItemCache::MAX_ENTRIES; ++it) {
+			msg.addItem(*it);
+			cache.downEnd[cache.downCount++] = msg.getLength();
+		}
+	}
+	cache.downItems.assign(reinterpret_cast<const char*>(msg.getBuffer()) + NetworkMessage::INITIAL_BUFFER_POSITION, msg.getLength());
+	return cache;
+}
+
 void Tile::onAddTileItem(Item* item)
 {
+	++itemVersion;
+
 	if (item->hasProperty(CONST_PROP_MOVEABLE) || item->getContainer()) {
 		auto it = g_game.browseFields.find(this);
 		if (it != g_game.browseFields.end()) {
@@ -405,6 +494,8 @@ void Tile::onAddTileItem(Item* item)
 
 void Tile::onUpdateTileItem(Item* oldItem, const ItemType& oldType, Item* newItem, const ItemType& newType)
 {
+	++itemVersion;
+
 	if (newItem->hasProperty(CONST_PROP_MOVEABLE) || newItem->getContainer()) {
 		auto it = g_game.browseFields.find(this);
 		if (it != g_game.browseFields.end()) {
@@ -443,6 +534,8 @@ void Tile::onUpdateTileItem(Item* oldItem, const ItemType& oldType, Item* newIte
 
 void Tile::onRemoveTileItem(const SpectatorHashSet& spectators, const std::vector<int32_t>& oldStackPosVector, Item* item)
 {
+	++itemVersion;
+
 	if (item->hasProperty(CONST_PROP_MOVEABLE) || item->getContainer()) {
 		auto it = g_game.browseFields.find(this);
 		if (it != g_game.browseFields.end()) {
@@ -1457,6 +1550,8 @@ void Tile::internalAddThing(uint32_t, Thing* thing)
 			return;
 		}
 
+		++itemVersion;
+
 		const ItemType& itemType = Item::items[item->getID()];
 		if (itemType.isGroundTile()) {
 			if (ground == nullptr) {
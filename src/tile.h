@@ -149,6 +149,25 @@ class TileItemVector : private ItemVector
 		uint16_t downItemCount = 0;
 };
 
+// Client encoding of the items on a tile, reused by map descriptions until
+// the tile's item version moves past the one it was built from. A bounded
+// pool holds them, a tile that was not described lately loses its own to
+// another one.
+struct TileItemCache
+{
+	static constexpr uint8_t MAX_ENTRIES = 10;
+
+	uint64_t generation = 0; // new every time the pool hands it to a tile
+	uint32_t version = 0;
+	bool used = false; // described since the pool last passed by
+	uint8_t topCount = 0; // ground and top items
+	uint8_t downCount = 0;
+	uint8_t topEnd[MAX_ENTRIES]; // end offset of every entry in topItems
+	uint8_t downEnd[MAX_ENTRIES];
+	std::string topItems;
+	std::string downItems;
+};
+
 class Tile : public Cylinder
 {
 	public:
@@ -250,10 +269,10 @@ class Tile : public Cylinder
 		void addThing(Thing* thing) override final;
 		void addThing(int32_t index, Thing* thing) override;
 
-		void updateThing(Thing* thing, uint16_t itemId, uint32_t count) override final;
-		void replaceThing(uint32_t index, Thing* thing) override final;
+		void updateThing(Thing* thing, uint16_t itemId, uint32_t count) override;
+		void replaceThing(uint32_t index, Thing* thing) override;
 
-		void removeThing(Thing* thing, uint32_t count) override final;
+		void removeThing(Thing* thing, uint32_t count) override;
 
 		void removeCreature(Creature* creature);
 
@@ -263,8 +282,8 @@ class Tile : public Cylinder
 		uint32_t getItemTypeCount(uint16_t itemId, int32_t subType = -1) const override final;
 		Thing* getThing(size_t index) const override final;
 
-		void postAddNotification(Thing* thing, const Cylinder* oldParent, int32_t index, cylinderlink_t link = LINK_OWNER) override final;
-		void postRemoveNotification(Thing* thing, const Cylinder* newParent, int32_t index, cylinderlink_t link = LINK_OWNER) override final;
+		void postAddNotification(Thing* thing, const Cylinder* oldParent, int32_t index, cylinderlink_t link = LINK_OWNER) override;
+		void postRemoveNotification(Thing* thing, const Cylinder* newParent, int32_t index, cylinderlink_t link = LINK_OWNER) override;
 
 		void internalAddThing(Thing* thing) override final;
 		void internalAddThing(uint32_t index, Thing* thing) override;
@@ -284,7 +303,13 @@ class Tile : public Cylinder
 		}
 		void setGround(Item* item) {
 			ground = item;
+			++itemVersion;
+		}
+
+		uint32_t getItemVersion() const {
+			return itemVersion;
 		}
+		const TileItemCache& getItemCache() const;
 
 		SoundEffectClasses getMusic() const {
 			return music;
@@ -303,8 +328,11 @@ class Tile : public Cylinder
 		void resetTileFlags(const Item* item);
 
 		Item* ground = nullptr;
+		mutable TileItemCache* itemCache = nullptr; // owned by the pool, ours while the generation matches
+		mutable uint64_t itemCacheGeneration = 0;
 		Position tilePos;
 		uint32_t flags = 0;
+		uint32_t itemVersion = 1;
 		SoundEffectClasses music = CONST_SE_NONE;
 };
 
@@ -857,6 +857,15 @@ uint32_t adlerChecksum(const uint8_t* data, size_t length)
 	return (b << 16) | a;
 }
 
+uint64_t fnv1aHash(const char* data, size_t length, uint64_t hash/* = 14695981039346656037ULL*/)
+{
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= static_cast<uint8_t>(data[i]);
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
 std::string ucfirst(std::string str)
 {
 	for (char& i : str) {
@@ -76,6 +76,7 @@ PokemonType_t getPokemonElementType(const std::string& strValue);
 std::string getSkillName(uint8_t skillid);
 
 uint32_t adlerChecksum(const uint8_t* data, size_t length);
+uint64_t fnv1aHash(const char* data, size_t length, uint64_t hash = 14695981039346656037ULL);
 
 std::string ucfirst(std::string str);
 std::string ucwords(std::string str);